@@ -1,27 +1,136 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <string>
+#include <type_traits>
 #include <vector>
-#include <mutex>
 
 using namespace std::string_literals;
 
-template <typename Key, typename Value>
+// -:       ,      
+const size_t CACHE_LINE_SIZE = 64;
+
+//-,      .     
+//  .  Mutex = std::shared_mutex     
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename Mutex = std::mutex>
 class ConcurrentMap {
+private:
+    template <typename LockType, typename = void>
+    struct IsSharedMutex : std::false_type {
+    };
+
+    template <typename LockType>
+    struct IsSharedMutex<LockType, std::void_t<decltype(std::declval<LockType&>().lock_shared())>> : std::true_type {
+    };
+
+    using ReadLock = std::conditional_t<IsSharedMutex<Mutex>::value, std::shared_lock<Mutex>, std::unique_lock<Mutex>>;
+
+    struct Slot {
+        Key key{};
+        Value value{};
+        size_t hash = 0;
+        bool is_used = false;
+    };
+
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys"s);
+    struct alignas(CACHE_LINE_SIZE) Bucket {
+        mutable Mutex m_;
+        std::vector<Slot> slots_;
+        size_t size_ = 0;
+
+        //   slots_.size(),   
+        size_t FindSlot(const Key& key, size_t hash) const {
+            if (slots_.empty()) {
+                return 0;
+            }
+
+            const size_t mask = slots_.size() - 1;
+            for (size_t index = GetHomeSlot(hash); slots_[index].is_used; index = (index + 1) & mask) {
+                if (slots_[index].hash == hash && slots_[index].key == key) {
+                    return index;
+                }
+            }
+            return slots_.size();
+        }
+
+        Value& GetOrInsert(const Key& key, size_t hash) {
+            const size_t found = FindSlot(key, hash);
+            if (found < slots_.size()) {
+                return slots_[found].value;
+            }
+
+            //    3/4
+            if ((size_ + 1) * 4 > slots_.size() * 3) {
+                Rehash(std::max<size_t>(8, slots_.size() * 2));
+            }
+
+            const size_t mask = slots_.size() - 1;
+            size_t index = GetHomeSlot(hash);
+            while (slots_[index].is_used) {
+                index = (index + 1) & mask;
+            }
+
+            slots_[index] = { key, Value{}, hash, true };
+            ++size_;
+            return slots_[index].value;
+        }
+
+        //      ,    
+        void Erase(const Key& key, size_t hash) {
+            size_t index = FindSlot(key, hash);
+            if (index == slots_.size()) {
+                return;
+            }
+
+            const size_t mask = slots_.size() - 1;
+            for (size_t next = (index + 1) & mask; slots_[next].is_used; next = (next + 1) & mask) {
+                const size_t home = GetHomeSlot(slots_[next].hash);
+                const bool can_move = index <= next ? (home <= index || home > next) : (home <= index && home > next);
+                if (can_move) {
+                    slots_[index] = std::move(slots_[next]);
+                    index = next;
+                }
+            }
 
-    struct Bucket {
-        std::mutex m_;
-        std::map<Key, Value> bucket_;
+            slots_[index] = Slot{};
+            --size_;
+        }
+
+        size_t GetHomeSlot(size_t hash) const {
+            return (hash >> 16) & (slots_.size() - 1);
+        }
+
+        void Rehash(size_t slot_count) {
+            std::vector<Slot> old_slots(slot_count);
+            std::swap(slots_, old_slots);
+            size_ = 0;
+
+            for (Slot& slot : old_slots) {
+                if (slot.is_used) {
+                    const size_t mask = slots_.size() - 1;
+                    size_t index = GetHomeSlot(slot.hash);
+                    while (slots_[index].is_used) {
+                        index = (index + 1) & mask;
+                    }
+                    slots_[index] = std::move(slot);
+                    ++size_;
+                }
+            }
+        }
     };
 
     struct Access {
-        std::lock_guard<std::mutex> guard;
+        std::unique_lock<Mutex> guard;
         Value& ref_to_value;
 
-        Access(const Key& key, Bucket& bucket)
-            :guard(bucket.m_), ref_to_value(bucket.bucket_[key]) {
+        Access(const Key& key, size_t hash, Bucket& bucket)
+            :guard(bucket.m_), ref_to_value(bucket.GetOrInsert(key, hash)) {
         }
     };
 
@@ -30,30 +139,70 @@ public:
     };
 
     Access operator[](const Key& key) {
-        Bucket& bucket = GetBucketRef(key);
-        return { key, bucket };
+        const size_t hash = GetHash(key);
+        return { key, hash, GetBucketRef(hash) };
     }
 
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result_map;
-        for (Bucket& bucket : segments_) {
-            std::lock_guard guard(bucket.m_);
-            result_map.insert(bucket.bucket_.begin(), bucket.bucket_.end());
+    std::optional<Value> Get(const Key& key) const {
+        const size_t hash = GetHash(key);
+        const Bucket& bucket = GetBucketRef(hash);
+        ReadLock guard(bucket.m_);
+
+        const size_t index = bucket.FindSlot(key, hash);
+        if (index == bucket.slots_.size()) {
+            return std::nullopt;
         }
-        return result_map;
+        return bucket.slots_[index].value;
     }
 
     void erase(const Key& key) {
-        Bucket& bucket = GetBucketRef(key);
+        const size_t hash = GetHash(key);
+        Bucket& bucket = GetBucketRef(hash);
         std::lock_guard guard(bucket.m_);
-        bucket.bucket_.erase(key);
+        bucket.Erase(key, hash);
+    }
+
+    //  :     ,    
+    template <typename ExecutionPolicy, typename Function>
+    void ForEach(const ExecutionPolicy& policy, Function function) {
+        std::for_each(policy, segments_.begin(), segments_.end(),
+            [&function](Bucket& bucket) {
+                std::lock_guard guard(bucket.m_);
+                for (Slot& slot : bucket.slots_) {
+                    if (slot.is_used) {
+                        function(static_cast<const Key&>(slot.key), slot.value);
+                    }
+                }
+            }
+        );
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() {
+        std::map<Key, Value> result_map;
+        ForEach(std::execution::seq,
+            [&result_map](const Key& key, Value& value) {
+                result_map.emplace(key, value);
+            }
+        );
+        return result_map;
     }
 
 private:
     std::vector<Bucket> segments_;
 
-    Bucket& GetBucketRef(const Key& key) {
-        size_t segment_num = static_cast<uint64_t>(key) % segments_.size();
-        return segments_[segment_num];
+    //std::hash      ,    
+    static size_t GetHash(const Key& key) {
+        uint64_t hash = Hash{}(key);
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+        return static_cast<size_t>(hash ^ (hash >> 31));
+    }
+
+    Bucket& GetBucketRef(size_t hash) {
+        return segments_[hash % segments_.size()];
+    }
+
+    const Bucket& GetBucketRef(size_t hash) const {
+        return segments_[hash % segments_.size()];
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,503 @@
+#include "corpus_loader.h"
+
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <execution>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+template <typename Type>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        :capacity_(capacity) {
+    }
+
+    //,     .  false,   
+    bool Push(Type value) {
+        unique_lock lock(mutex_);
+        not_full_.wait(lock, [this] { return queue_.size() < capacity_ || is_closed_; });
+        if (is_closed_) {
+            return false;
+        }
+
+        queue_.push(move(value));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // nullopt,     
+    optional<Type> Pop() {
+        unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this] { return !queue_.empty() || is_closed_; });
+        if (queue_.empty()) {
+            return nullopt;
+        }
+
+        Type value = move(queue_.front());
+        queue_.pop();
+        not_full_.notify_one();
+        return value;
+    }
+
+    void Close() {
+        lock_guard guard(mutex_);
+        is_closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    queue<Type> queue_;
+    bool is_closed_ = false;
+    mutex mutex_;
+    condition_variable not_empty_;
+    condition_variable not_full_;
+};
+
+struct CorpusRecord {
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    vector<int> ratings;
+    string_view text;
+    // JSON  escape-    
+    string unescaped_text;
+    bool is_unescaped = false;
+    bool is_valid = true;
+    SearchServer::PreparedDocument document;
+};
+
+//    ; text    buffer
+struct CorpusChunk {
+    string buffer;
+    vector<CorpusRecord> records;
+};
+
+using ChunkQueue = BoundedQueue<unique_ptr<CorpusChunk>>;
+
+optional<DocumentStatus> ParseStatus(string_view text) {
+    if (text == "ACTUAL"sv) {
+        return DocumentStatus::ACTUAL;
+    }
+    if (text == "IRRELEVANT"sv) {
+        return DocumentStatus::IRRELEVANT;
+    }
+    if (text == "BANNED"sv) {
+        return DocumentStatus::BANNED;
+    }
+    if (text == "REMOVED"sv) {
+        return DocumentStatus::REMOVED;
+    }
+    return nullopt;
+}
+
+bool ParseInt(string_view text, int& value) {
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    return error == errc() && end == text.data() + text.size();
+}
+
+bool ParseTsvLine(string_view line, CorpusRecord& record) {
+    string_view fields[3];
+    for (string_view& field : fields) {
+        const size_t tab = line.find('\t');
+        if (tab == line.npos) {
+            return false;
+        }
+        field = line.substr(0, tab);
+        line.remove_prefix(tab + 1);
+    }
+
+    const optional<DocumentStatus> status = ParseStatus(fields[1]);
+    if (!ParseInt(fields[0], record.document_id) || !status) {
+        return false;
+    }
+    record.status = *status;
+
+    for (string_view rating_text : WordRange(fields[2])) {
+        int rating = 0;
+        if (!ParseInt(rating_text, rating)) {
+            return false;
+        }
+        record.ratings.push_back(rating);
+    }
+
+    record.text = line;
+    return true;
+}
+
+void SkipJsonSpaces(string_view& text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+}
+
+bool SkipJsonChar(string_view& text, char c) {
+    SkipJsonSpaces(text);
+    if (text.empty() || text.front() != c) {
+        return false;
+    }
+    text.remove_prefix(1);
+    return true;
+}
+
+//      
+bool ParseJsonString(string_view& text, string_view& value, bool& has_escapes) {
+    if (!SkipJsonChar(text, '"')) {
+        return false;
+    }
+
+    has_escapes = false;
+    for (size_t pos = 0; pos < text.size(); ++pos) {
+        if (text[pos] == '\\') {
+            has_escapes = true;
+            ++pos;
+        }
+        else if (text[pos] == '"') {
+            value = text.substr(0, pos);
+            text.remove_prefix(pos + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void AppendUtf8(string& output, uint32_t code_point) {
+    if (code_point < 0x80) {
+        output.push_back(static_cast<char>(code_point));
+    }
+    else if (code_point < 0x800) {
+        output.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+        output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+    else if (code_point < 0x10000) {
+        output.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+        output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+    else {
+        output.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+        output.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+        output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+}
+
+bool ParseHex4(string_view text, uint32_t& value) {
+    const auto [end, error] = from_chars(text.data(), text.data() + min<size_t>(text.size(), 4), value, 16);
+    return error == errc() && end == text.data() + 4;
+}
+
+bool UnescapeJsonString(string_view text, string& output) {
+    output.reserve(text.size());
+    for (size_t pos = 0; pos < text.size(); ++pos) {
+        if (text[pos] != '\\') {
+            output.push_back(text[pos]);
+            continue;
+        }
+
+        if (++pos == text.size()) {
+            return false;
+        }
+        switch (text[pos]) {
+        case '"': output.push_back('"'); break;
+        case '\\': output.push_back('\\'); break;
+        case '/': output.push_back('/'); break;
+        case 'b': output.push_back('\b'); break;
+        case 'f': output.push_back('\f'); break;
+        case 'n': output.push_back('\n'); break;
+        case 'r': output.push_back('\r'); break;
+        case 't': output.push_back('\t'); break;
+        case 'u': {
+            uint32_t code_point = 0;
+            if (!ParseHex4(text.substr(pos + 1), code_point)) {
+                return false;
+            }
+            pos += 4;
+
+            //  BMP   
+            uint32_t low_surrogate = 0;
+            if (code_point >= 0xD800 && code_point < 0xDC00 && text.substr(pos + 1, 2) == "\\u"sv
+                && ParseHex4(text.substr(pos + 3), low_surrogate) && low_surrogate >= 0xDC00 && low_surrogate < 0xE000) {
+                code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low_surrogate - 0xDC00);
+                pos += 6;
+            }
+            AppendUtf8(output, code_point);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParseJsonInt(string_view& text, int& value) {
+    SkipJsonSpaces(text);
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc()) {
+        return false;
+    }
+    text.remove_prefix(end - text.data());
+    return true;
+}
+
+//   : , , ,   
+bool SkipJsonValue(string_view& text) {
+    SkipJsonSpaces(text);
+    int depth = 0;
+    while (!text.empty()) {
+        const char c = text.front();
+        if (c == '"') {
+            string_view value;
+            bool has_escapes = false;
+            if (!ParseJsonString(text, value, has_escapes)) {
+                return false;
+            }
+        }
+        else if (depth == 0 && (c == ',' || c == '}')) {
+            return true;
+        }
+        else {
+            if (c == '[' || c == '{') {
+                ++depth;
+            }
+            else if (c == ']' || c == '}') {
+                --depth;
+            }
+            text.remove_prefix(1);
+        }
+    }
+    return false;
+}
+
+bool ParseJsonLine(string_view line, CorpusRecord& record) {
+    if (!SkipJsonChar(line, '{')) {
+        return false;
+    }
+
+    bool has_id = false;
+    bool has_text = false;
+    bool is_first = true;
+    while (!SkipJsonChar(line, '}')) {
+        if (!is_first && !SkipJsonChar(line, ',')) {
+            return false;
+        }
+        is_first = false;
+
+        string_view key;
+        string_view value;
+        bool has_escapes = false;
+        if (!ParseJsonString(line, key, has_escapes) || !SkipJsonChar(line, ':')) {
+            return false;
+        }
+
+        if (key == "id"sv) {
+            has_id = ParseJsonInt(line, record.document_id);
+            if (!has_id) {
+                return false;
+            }
+        }
+        else if (key == "status"sv) {
+            if (!ParseJsonString(line, value, has_escapes)) {
+                return false;
+            }
+            const optional<DocumentStatus> status = ParseStatus(value);
+            if (!status) {
+                return false;
+            }
+            record.status = *status;
+        }
+        else if (key == "ratings"sv) {
+            if (!SkipJsonChar(line, '[')) {
+                return false;
+            }
+            while (!SkipJsonChar(line, ']')) {
+                int rating = 0;
+                if ((!record.ratings.empty() && !SkipJsonChar(line, ',')) || !ParseJsonInt(line, rating)) {
+                    return false;
+                }
+                record.ratings.push_back(rating);
+            }
+        }
+        else if (key == "text"sv) {
+            if (!ParseJsonString(line, value, has_escapes)) {
+                return false;
+            }
+            if (has_escapes) {
+                record.is_unescaped = true;
+                if (!UnescapeJsonString(value, record.unescaped_text)) {
+                    return false;
+                }
+            }
+            record.text = value;
+            has_text = true;
+        }
+        else if (!SkipJsonValue(line)) {
+            return false;
+        }
+    }
+
+    return has_id && has_text;
+}
+
+void ParseChunk(CorpusChunk& chunk, CorpusFormat format) {
+    string_view text = chunk.buffer;
+    while (!text.empty()) {
+        const size_t line_end = text.find('\n');
+        string_view line = text.substr(0, line_end);
+        text.remove_prefix(line_end == text.npos ? text.size() : line_end + 1);
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+
+        CorpusRecord& record = chunk.records.emplace_back();
+        record.is_valid = format == CorpusFormat::TSV ? ParseTsvLine(line, record) : ParseJsonLine(line, record);
+    }
+}
+
+//   :      ,
+//      
+void ReadChunks(istream& input, CorpusFormat format, ChunkQueue& parsed_chunks) {
+    string tail;
+    bool is_last = false;
+    while (!is_last) {
+        auto chunk = make_unique<CorpusChunk>();
+        chunk->buffer.resize(tail.size() + CORPUS_CHUNK_SIZE);
+        copy(tail.begin(), tail.end(), chunk->buffer.begin());
+
+        input.read(chunk->buffer.data() + tail.size(), CORPUS_CHUNK_SIZE);
+        const size_t read_size = static_cast<size_t>(input.gcount());
+        chunk->buffer.resize(tail.size() + read_size);
+        is_last = read_size < CORPUS_CHUNK_SIZE;
+
+        size_t end = chunk->buffer.size();
+        if (!is_last) {
+            const size_t line_end = chunk->buffer.rfind('\n');
+            end = line_end == string::npos ? 0 : line_end + 1;
+        }
+        tail.assign(chunk->buffer, end);
+        chunk->buffer.resize(end);
+
+        if (chunk->buffer.empty()) {
+            continue;
+        }
+
+        ParseChunk(*chunk, format);
+        if (!parsed_chunks.Push(move(chunk))) {
+            return;
+        }
+    }
+    parsed_chunks.Close();
+}
+
+//     ,    
+void PrepareChunks(const SearchServer& search_server, ChunkQueue& parsed_chunks, ChunkQueue& prepared_chunks) {
+    while (optional<unique_ptr<CorpusChunk>> chunk = parsed_chunks.Pop()) {
+        for_each(execution::par, (*chunk)->records.begin(), (*chunk)->records.end(),
+            [&search_server](CorpusRecord& record) {
+                if (!record.is_valid) {
+                    return;
+                }
+                try {
+                    record.document = search_server.PrepareDocument(record.is_unescaped ? string_view(record.unescaped_text) : record.text);
+                }
+                catch (const invalid_argument&) {
+                    record.is_valid = false;
+                }
+            }
+        );
+
+        if (!prepared_chunks.Push(move(*chunk))) {
+            return;
+        }
+    }
+    prepared_chunks.Close();
+}
+
+} // namespace
+
+ostream& operator<<(ostream& output, const CorpusLoadStats& stats) {
+    const double megabytes = stats.byte_count / 1048576.0;
+    output << "{ "s
+           << "documents = "s << stats.document_count << ", "s
+           << "errors = "s << stats.error_count << ", "s
+           << "megabytes = "s << megabytes << ", "s
+           << "seconds = "s << stats.seconds << ", "s
+           << "megabytes_per_second = "s << (stats.seconds > 0 ? megabytes / stats.seconds : 0.0) << " }"s;
+
+    return output;
+}
+
+CorpusLoadStats LoadCorpus(SearchServer& search_server, istream& input, CorpusFormat format, ostream* progress) {
+    const auto start_time = chrono::steady_clock::now();
+    CorpusLoadStats stats;
+
+    ChunkQueue parsed_chunks(CORPUS_PIPELINE_DEPTH);
+    ChunkQueue prepared_chunks(CORPUS_PIPELINE_DEPTH);
+    thread reader([&] { ReadChunks(input, format, parsed_chunks); });
+    thread preparer([&] { PrepareChunks(search_server, parsed_chunks, prepared_chunks); });
+
+    //     :     
+    try {
+        while (optional<unique_ptr<CorpusChunk>> chunk = prepared_chunks.Pop()) {
+            for (const CorpusRecord& record : (*chunk)->records) {
+                if (!record.is_valid) {
+                    ++stats.error_count;
+                    continue;
+                }
+                try {
+                    search_server.AddDocument(record.document_id, record.document, record.status, record.ratings);
+                    ++stats.document_count;
+                }
+                catch (const invalid_argument&) {
+                    ++stats.error_count;
+                }
+                catch (const runtime_error&) {
+                    ++stats.error_count;
+                }
+            }
+
+            stats.byte_count += (*chunk)->buffer.size();
+            stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+            if (progress) {
+                *progress << stats << endl;
+            }
+        }
+    }
+    catch (...) {
+        parsed_chunks.Close();
+        prepared_chunks.Close();
+        reader.join();
+        preparer.join();
+        throw;
+    }
+
+    reader.join();
+    preparer.join();
+
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    return stats;
+}
+
+CorpusLoadStats LoadCorpus(SearchServer& search_server, const string& path, CorpusFormat format, ostream* progress) {
+    ifstream input(path, ios::binary);
+    if (!input) {
+        throw invalid_argument("Cannot open corpus file "s + path);
+    }
+
+    return LoadCorpus(search_server, input, format, progress);
+}
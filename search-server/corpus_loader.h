@@ -0,0 +1,31 @@
+#pragma once
+#include "search_server.h"
+
+#include <iostream>
+#include <string>
+
+//           
+const size_t CORPUS_CHUNK_SIZE = 4 << 20;
+const size_t CORPUS_PIPELINE_DEPTH = 4;
+
+//TSV: id, ,     ,  .
+//JSONL: {"id": 1, "status": "ACTUAL", "ratings": [1, 2], "text": "..."}
+enum class CorpusFormat {
+    TSV,
+    JSONL,
+};
+
+struct CorpusLoadStats {
+    size_t document_count = 0;
+    size_t error_count = 0;
+    size_t byte_count = 0;
+    double seconds = 0;
+};
+
+std::ostream& operator<<(std::ostream& output, const CorpusLoadStats& stats);
+
+//  :    ,      ,
+//  .    ,     .
+//  progress,      
+CorpusLoadStats LoadCorpus(SearchServer& search_server, std::istream& input, CorpusFormat format, std::ostream* progress = nullptr);
+CorpusLoadStats LoadCorpus(SearchServer& search_server, const std::string& path, CorpusFormat format, std::ostream* progress = nullptr);
@@ -0,0 +1,242 @@
+#include "document_store.h"
+#include "memory_usage.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const size_t MIN_MATCH_LENGTH = 4;
+const size_t MAX_MATCH_OFFSET = 65535;
+const int HASH_BITS = 12;
+
+uint32_t ReadSequence(const char* data) {
+    uint32_t sequence;
+    memcpy(&sequence, data, sizeof(sequence));
+    return sequence;
+}
+
+//  15   255  ,   LZ4
+void WriteLength(string& output, size_t length) {
+    for (; length >= 255; length -= 255) {
+        output.push_back(static_cast<char>(255));
+    }
+    output.push_back(static_cast<char>(length));
+}
+
+size_t ReadLength(string_view input, size_t& pos) {
+    size_t length = 0;
+    unsigned char byte = 255;
+    while (byte == 255) {
+        if (pos >= input.size()) {
+            throw invalid_argument("Corrupted compressed text"s);
+        }
+        byte = static_cast<unsigned char>(input[pos++]);
+        length += byte;
+    }
+    return length;
+}
+
+void WriteSequence(string& output, string_view literals, size_t offset, size_t match_length) {
+    const size_t match_code = match_length > 0 ? match_length - MIN_MATCH_LENGTH : 0;
+    output.push_back(static_cast<char>((min<size_t>(literals.size(), 15) << 4) | min<size_t>(match_code, 15)));
+    if (literals.size() >= 15) {
+        WriteLength(output, literals.size() - 15);
+    }
+    output.append(literals);
+
+    if (match_length == 0) {
+        return;
+    }
+    output.push_back(static_cast<char>(offset & 0xFF));
+    output.push_back(static_cast<char>(offset >> 8));
+    if (match_code >= 15) {
+        WriteLength(output, match_code - 15);
+    }
+}
+
+} // namespace
+
+string CompressText(string_view text) {
+    string output;
+    output.reserve(text.size() / 2 + 16);
+
+    vector<int> table(1 << HASH_BITS, -1);
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (pos + MIN_MATCH_LENGTH <= text.size()) {
+        const uint32_t sequence = ReadSequence(text.data() + pos);
+        const uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        const int candidate = table[hash];
+        table[hash] = static_cast<int>(pos);
+
+        if (candidate < 0 || pos - candidate > MAX_MATCH_OFFSET || ReadSequence(text.data() + candidate) != sequence) {
+            ++pos;
+            continue;
+        }
+
+        size_t match_length = MIN_MATCH_LENGTH;
+        while (pos + match_length < text.size() && text[candidate + match_length] == text[pos + match_length]) {
+            ++match_length;
+        }
+        WriteSequence(output, text.substr(anchor, pos - anchor), pos - candidate, match_length);
+        pos += match_length;
+        anchor = pos;
+    }
+
+    //    
+    WriteSequence(output, text.substr(anchor), 0, 0);
+    return output;
+}
+
+string DecompressText(string_view compressed) {
+    string output;
+    size_t pos = 0;
+    while (pos < compressed.size()) {
+        const unsigned char token = static_cast<unsigned char>(compressed[pos++]);
+
+        size_t literal_length = token >> 4;
+        if (literal_length == 15) {
+            literal_length += ReadLength(compressed, pos);
+        }
+        if (pos + literal_length > compressed.size()) {
+            throw invalid_argument("Corrupted compressed text"s);
+        }
+        output.append(compressed.substr(pos, literal_length));
+        pos += literal_length;
+
+        if (pos == compressed.size()) {
+            break;
+        }
+        if (pos + 2 > compressed.size()) {
+            throw invalid_argument("Corrupted compressed text"s);
+        }
+        const size_t offset = static_cast<unsigned char>(compressed[pos]) | (static_cast<unsigned char>(compressed[pos + 1]) << 8);
+        pos += 2;
+        size_t match_length = token & 15;
+        if (match_length == 15) {
+            match_length += ReadLength(compressed, pos);
+        }
+        match_length += MIN_MATCH_LENGTH;
+        if (offset == 0 || offset > output.size()) {
+            throw invalid_argument("Corrupted compressed text"s);
+        }
+
+        //     ,   
+        const size_t from = output.size() - offset;
+        for (size_t i = 0; i < match_length; ++i) {
+            output.push_back(output[from + i]);
+        }
+    }
+
+    return output;
+}
+
+void DocumentStore::SetStorage(DocumentStorage storage) {
+    storage_ = storage;
+}
+
+DocumentStorage DocumentStore::GetStorage() const {
+    return storage_;
+}
+
+void DocumentStore::Add(int document_id, string_view text) {
+    switch (storage_) {
+    case DocumentStorage::FULL: {
+        const auto [it, _] = texts_.emplace(document_id, string(text));
+        text_bytes_ += GetHeapSize(it->second);
+        break;
+    }
+    case DocumentStorage::COMPRESSED:
+        //   ,  ,      DOCUMENT_BLOCK_SIZE
+        if (!open_block_.empty() && open_block_.size() + text.size() > DOCUMENT_BLOCK_SIZE) {
+            SealBlock();
+        }
+        locations_[document_id] = { static_cast<uint32_t>(blocks_.size()), static_cast<uint32_t>(open_block_.size()), static_cast<uint32_t>(text.size()) };
+        open_block_.append(text);
+        open_block_live_size_ += text.size();
+        break;
+    case DocumentStorage::NONE:
+        break;
+    }
+}
+
+optional<string> DocumentStore::Get(int document_id) const {
+    const auto text_it = texts_.find(document_id);
+    if (text_it != texts_.end()) {
+        return text_it->second;
+    }
+
+    const auto location_it = locations_.find(document_id);
+    if (location_it == locations_.end()) {
+        return nullopt;
+    }
+
+    const Location& location = location_it->second;
+    if (location.size == 0) {
+        return string();
+    }
+    if (location.block == blocks_.size()) {
+        return open_block_.substr(location.offset, location.size);
+    }
+    //      
+    return DecompressText(blocks_[location.block]).substr(location.offset, location.size);
+}
+
+void DocumentStore::Remove(int document_id) {
+    const auto text_it = texts_.find(document_id);
+    if (text_it != texts_.end()) {
+        text_bytes_ -= GetHeapSize(text_it->second);
+        texts_.erase(text_it);
+        return;
+    }
+
+    const auto location_it = locations_.find(document_id);
+    if (location_it == locations_.end()) {
+        return;
+    }
+
+    const Location location = location_it->second;
+    locations_.erase(location_it);
+    if (location.block == blocks_.size()) {
+        //       ,    
+        if ((open_block_live_size_ -= location.size) == 0) {
+            string().swap(open_block_);
+        }
+    }
+    else if (location.size > 0 && (block_live_sizes_[location.block] -= location.size) == 0) {
+        block_bytes_ -= GetHeapSize(blocks_[location.block]);
+        string().swap(blocks_[location.block]);
+    }
+}
+
+size_t DocumentStore::GetMemoryUsage() const {
+    return texts_.size() * GetTreeNodeSize<pair<const int, string>>() + text_bytes_
+        + locations_.size() * GetTreeNodeSize<pair<const int, Location>>()
+        + block_bytes_ + GetHeapSize(blocks_) + GetHeapSize(block_live_sizes_) + GetHeapSize(open_block_);
+}
+
+size_t DocumentStore::EstimateMemory(string_view text) const {
+    switch (storage_) {
+    case DocumentStorage::FULL:
+        return GetTreeNodeSize<pair<const int, string>>() + GetHeapSize(string(text));
+    case DocumentStorage::COMPRESSED:
+        // :     ,    
+        return GetTreeNodeSize<pair<const int, Location>>() + text.size();
+    case DocumentStorage::NONE:
+        break;
+    }
+    return 0;
+}
+
+void DocumentStore::SealBlock() {
+    string compressed = open_block_live_size_ > 0 ? CompressText(open_block_) : string();
+    compressed.shrink_to_fit();
+    block_bytes_ += GetHeapSize(compressed);
+    block_live_sizes_.push_back(open_block_live_size_);
+    blocks_.push_back(move(compressed));
+    string().swap(open_block_);
+    open_block_live_size_ = 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//        
+const size_t DOCUMENT_BLOCK_SIZE = 64 * 1024;
+
+enum class DocumentStorage {
+    FULL,
+    COMPRESSED,
+    NONE,
+};
+
+//  .    :   TermPool,
+//        
+class DocumentStore {
+public:
+    //  ,   
+    void SetStorage(DocumentStorage storage);
+    DocumentStorage GetStorage() const;
+
+    void Add(int document_id, std::string_view text);
+    //nullopt,     
+    std::optional<std::string> Get(int document_id) const;
+    void Remove(int document_id);
+
+    size_t GetMemoryUsage() const;
+    //       
+    size_t EstimateMemory(std::string_view text) const;
+
+private:
+    struct Location {
+        uint32_t block;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    void SealBlock();
+
+    DocumentStorage storage_ = DocumentStorage::FULL;
+
+    std::map<int, std::string> texts_;
+    size_t text_bytes_ = 0;
+
+    //       
+    std::vector<std::string> blocks_;
+    //       ;   
+    std::vector<size_t> block_live_sizes_;
+    std::string open_block_;
+    size_t open_block_live_size_ = 0;
+    std::map<int, Location> locations_;
+    size_t block_bytes_ = 0;
+};
+
+// LZ77  ,   LZ4:        64 
+std::string CompressText(std::string_view text);
+std::string DecompressText(std::string_view compressed);
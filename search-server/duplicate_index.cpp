@@ -0,0 +1,101 @@
+#include "duplicate_index.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// splitmix64
+uint64_t Mix(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ull;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+} // namespace
+
+bool operator==(const WordSetFingerprint& lhs, const WordSetFingerprint& rhs) {
+    return lhs.high == rhs.high && lhs.low == rhs.low;
+}
+
+bool operator<(const WordSetFingerprint& lhs, const WordSetFingerprint& rhs) {
+    return pair(lhs.high, lhs.low) < pair(rhs.high, rhs.low);
+}
+
+size_t WordSetFingerprintHasher::operator()(const WordSetFingerprint& fingerprint) const {
+    return static_cast<size_t>(fingerprint.low);
+}
+
+WordSetFingerprint ComputeWordSetFingerprint(const vector<int>& sorted_word_ids) {
+    //        128 
+    WordSetFingerprint fingerprint{ Mix(sorted_word_ids.size()), Mix(~sorted_word_ids.size()) };
+    for (int word_id : sorted_word_ids) {
+        const uint64_t value = static_cast<uint32_t>(word_id);
+        fingerprint.high = Mix(fingerprint.high ^ value);
+        fingerprint.low = Mix(fingerprint.low + (value << 32 | value));
+    }
+    return fingerprint;
+}
+
+int DuplicateIndex::Add(int document_id, const WordSetFingerprint& fingerprint) {
+    const auto [it, is_inserted] = fingerprint_to_original_.emplace(fingerprint, document_id);
+    if (is_inserted) {
+        return -1;
+    }
+
+    if (document_id > it->second) {
+        duplicates_.insert({ fingerprint, document_id });
+        return document_id;
+    }
+
+    const int displaced_id = it->second;
+    duplicates_.insert({ fingerprint, displaced_id });
+    it->second = document_id;
+    return displaced_id;
+}
+
+void DuplicateIndex::Remove(int document_id, const WordSetFingerprint& fingerprint) {
+    const auto it = fingerprint_to_original_.find(fingerprint);
+    if (it == fingerprint_to_original_.end()) {
+        return;
+    }
+
+    if (it->second != document_id) {
+        duplicates_.erase({ fingerprint, document_id });
+        return;
+    }
+
+    //     id 
+    const auto next = duplicates_.lower_bound({ fingerprint, 0 });
+    if (next != duplicates_.end() && next->first == fingerprint) {
+        it->second = next->second;
+        duplicates_.erase(next);
+    }
+    else {
+        fingerprint_to_original_.erase(it);
+    }
+}
+
+int DuplicateIndex::FindOriginal(const WordSetFingerprint& fingerprint) const {
+    const auto it = fingerprint_to_original_.find(fingerprint);
+    return it != fingerprint_to_original_.end() ? it->second : -1;
+}
+
+vector<int> DuplicateIndex::GetDuplicateIds() const {
+    vector<int> duplicate_ids;
+    duplicate_ids.reserve(duplicates_.size());
+    for (const auto& [fingerprint, document_id] : duplicates_) {
+        duplicate_ids.push_back(document_id);
+    }
+    sort(duplicate_ids.begin(), duplicate_ids.end());
+    return duplicate_ids;
+}
+
+size_t DuplicateIndex::GetMemoryUsage() const {
+    return fingerprint_to_original_.bucket_count() * sizeof(void*)
+        + fingerprint_to_original_.size() * GetHashNodeSize<pair<const WordSetFingerprint, int>>()
+        + duplicates_.size() * GetTreeNodeSize<pair<WordSetFingerprint, int>>();
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class DuplicatePolicy {
+    //     GetDuplicateIds
+    ALLOW,
+    //       id
+    REJECT,
+};
+
+//128-    id   
+struct WordSetFingerprint {
+    uint64_t high = 0;
+    uint64_t low = 0;
+};
+
+bool operator==(const WordSetFingerprint& lhs, const WordSetFingerprint& rhs);
+bool operator<(const WordSetFingerprint& lhs, const WordSetFingerprint& rhs);
+
+struct WordSetFingerprintHasher {
+    size_t operator()(const WordSetFingerprint& fingerprint) const;
+};
+
+WordSetFingerprint ComputeWordSetFingerprint(const std::vector<int>& sorted_word_ids);
+
+//    .    
+//  id,   RemoveDuplicates;    
+class DuplicateIndex {
+public:
+    // id ,  :     ; -1,   
+    int Add(int document_id, const WordSetFingerprint& fingerprint);
+    void Remove(int document_id, const WordSetFingerprint& fingerprint);
+
+    //    -1
+    int FindOriginal(const WordSetFingerprint& fingerprint) const;
+    //  id
+    std::vector<int> GetDuplicateIds() const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    std::unordered_map<WordSetFingerprint, int, WordSetFingerprintHasher> fingerprint_to_original_;
+    std::set<std::pair<WordSetFingerprint, int>> duplicates_;
+};
@@ -0,0 +1,127 @@
+#include "index_segment.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+
+using namespace std;
+
+IndexSegment::IndexSegment(const map<int, map<int, double>>& word_to_document_freqs) {
+    posting_offsets_.push_back(0);
+
+    for (const auto& [word_id, document_freqs] : word_to_document_freqs) {
+        if (document_freqs.empty()) {
+            continue;
+        }
+
+        word_ids_.push_back(word_id);
+        for (const auto& [document_id, term_freq] : document_freqs) {
+            postings_.push_back({ document_id, 0, term_freq });
+            document_ids_.push_back(document_id);
+        }
+        posting_offsets_.push_back(postings_.size());
+    }
+
+    IndexDocuments();
+}
+
+IndexSegment::IndexSegment(const vector<shared_ptr<IndexSegment>>& segments, const vector<vector<bool>>& deleted) {
+    map<int, vector<Posting>> word_to_postings;
+
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const IndexSegment& segment = *segments[i];
+        for (size_t word_index = 0; word_index < segment.word_ids_.size(); ++word_index) {
+            vector<Posting>& postings = word_to_postings[segment.word_ids_[word_index]];
+            for (size_t j = segment.posting_offsets_[word_index]; j < segment.posting_offsets_[word_index + 1]; ++j) {
+                const Posting& posting = segment.postings_[j];
+                if (!deleted[i][posting.document_index]) {
+                    postings.push_back(posting);
+                    document_ids_.push_back(posting.document_id);
+                }
+            }
+        }
+    }
+
+    posting_offsets_.push_back(0);
+    for (auto& [word_id, postings] : word_to_postings) {
+        if (postings.empty()) {
+            continue;
+        }
+
+        sort(postings.begin(), postings.end(),
+            [](const Posting& lhs, const Posting& rhs) {
+                return lhs.document_id < rhs.document_id;
+            });
+
+        word_ids_.push_back(word_id);
+        postings_.insert(postings_.end(), postings.begin(), postings.end());
+        posting_offsets_.push_back(postings_.size());
+    }
+
+    IndexDocuments();
+}
+
+IndexSegment::PostingRange IndexSegment::GetPostings(int word_id) const {
+    const auto it = lower_bound(word_ids_.begin(), word_ids_.end(), word_id);
+    if (it == word_ids_.end() || *it != word_id) {
+        return { postings_.end(), postings_.end() };
+    }
+
+    const size_t word_index = it - word_ids_.begin();
+    return { postings_.begin() + posting_offsets_[word_index], postings_.begin() + posting_offsets_[word_index + 1] };
+}
+
+bool IndexSegment::IsDeleted(int document_index) const {
+    return deleted_[document_index];
+}
+
+bool IndexSegment::MarkDeleted(int document_id) {
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    if (it == document_ids_.end() || *it != document_id) {
+        return false;
+    }
+
+    const size_t document_index = it - document_ids_.begin();
+    if (deleted_[document_index]) {
+        return false;
+    }
+    deleted_[document_index] = true;
+    ++deleted_count_;
+    return true;
+}
+
+const vector<bool>& IndexSegment::GetDeleted() const {
+    return deleted_;
+}
+
+int IndexSegment::GetDocumentId(int document_index) const {
+    return document_ids_[document_index];
+}
+
+int IndexSegment::GetDocumentCount() const {
+    return static_cast<int>(document_ids_.size());
+}
+
+int IndexSegment::GetLiveDocumentCount() const {
+    return GetDocumentCount() - deleted_count_;
+}
+
+size_t IndexSegment::GetMemoryUsage() const {
+    return sizeof(IndexSegment) + GetHeapSize(document_ids_) + deleted_.capacity() / 8
+        + GetHeapSize(word_ids_) + GetHeapSize(posting_offsets_) + GetHeapSize(postings_);
+}
+
+//  ,       
+void IndexSegment::IndexDocuments() {
+    sort(document_ids_.begin(), document_ids_.end());
+    document_ids_.erase(unique(document_ids_.begin(), document_ids_.end()), document_ids_.end());
+    document_ids_.shrink_to_fit();
+    deleted_.assign(document_ids_.size(), false);
+
+    for (Posting& posting : postings_) {
+        posting.document_index = static_cast<int>(lower_bound(document_ids_.begin(), document_ids_.end(), posting.document_id) - document_ids_.begin());
+    }
+
+    word_ids_.shrink_to_fit();
+    posting_offsets_.shrink_to_fit();
+    postings_.shrink_to_fit();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "paginator.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+//   .    id   SearchServer,
+//      .      .
+class IndexSegment {
+public:
+    struct Posting {
+        int document_id;
+        int document_index;
+        double term_freq;
+    };
+
+    using PostingRange = IteratorRange<std::vector<Posting>::const_iterator>;
+
+    explicit IndexSegment(const std::map<int, std::map<int, double>>& word_to_document_freqs);
+    // ; deleted        
+    IndexSegment(const std::vector<std::shared_ptr<IndexSegment>>& segments, const std::vector<std::vector<bool>>& deleted);
+
+    PostingRange GetPostings(int word_id) const;
+
+    bool IsDeleted(int document_index) const;
+    //true,       .       id
+    // :         
+    bool MarkDeleted(int document_id);
+    const std::vector<bool>& GetDeleted() const;
+
+    int GetDocumentId(int document_index) const;
+    int GetDocumentCount() const;
+    int GetLiveDocumentCount() const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    std::vector<int> document_ids_;
+    std::vector<bool> deleted_;
+    int deleted_count_ = 0;
+
+    std::vector<int> word_ids_;
+    std::vector<size_t> posting_offsets_;
+    std::vector<Posting> postings_;
+
+    void IndexDocuments();
+};
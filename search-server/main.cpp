@@ -1,11 +1,623 @@
 #include "search_server.h"
+#include "process_queries.h"
+#include "corpus_loader.h"
 #include "log_duration.h"
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
 #include <execution>
 #include <iostream>
+#include <map>
+#include <new>
 #include <random>
+#include <set>
+#include <shared_mutex>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 using namespace std;
+thread_local size_t allocation_count = 0;
+void* operator new(size_t size) {
+    ++allocation_count;
+    if (void* ptr = malloc(size)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+//GCC  ,  operator new     malloc,    free  
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+#pragma GCC diagnostic pop
+void TestMatchDocuments() {
+    SearchServer search_server("and in on"s);
+    search_server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::BANNED, { 7, 2, 7 });
+    search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+    search_server.AddDocument(4, "fluffy dog and white collar"s, DocumentStatus::IRRELEVANT, { 9 });
+
+    const string query = "fluffy white collar -eyes"s;
+    const vector<int> document_ids = { 4, 1, 3, 2 };
+    const auto results = search_server.MatchDocuments(query, document_ids);
+    const auto par_results = search_server.MatchDocuments(execution::par, query, document_ids);
+    assert(results.size() == document_ids.size() && par_results == results);
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        assert(results[i] == search_server.MatchDocument(query, document_ids[i]));
+    }
+    assert(get<0>(results[2]).empty());
+
+    try {
+        search_server.MatchDocuments(query, { 1, 5 });
+        assert(false);
+    }
+    catch (const out_of_range&) {
+    }
+}
+void TestMemoryBudget() {
+    SearchServer search_server("and in on"s);
+    search_server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    const MemoryUsage memory_usage = search_server.GetMemoryUsage();
+    assert(memory_usage.documents > 0 && memory_usage.word_freqs > 0 && memory_usage.dictionary > 0);
+
+    //      
+    search_server.SetMemoryBudget(memory_usage.Total() + 1);
+    assert(search_server.GetMemoryBudget() == memory_usage.Total() + 1);
+    try {
+        search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+        assert(false);
+    }
+    catch (const runtime_error&) {
+    }
+    assert(search_server.GetDocumentCount() == 1);
+    assert(search_server.FindTopDocuments("fluffy"s).empty());
+    assert(search_server.GetMemoryUsage().Total() == memory_usage.Total());
+
+    search_server.SetMemoryBudget(0);
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    assert(search_server.FindTopDocuments("fluffy"s).size() == 1);
+
+    //     
+    search_server.FlushSegment();
+    search_server.SetMemoryBudget(search_server.GetMemoryUsage().Total() + 1);
+    try {
+        search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+        assert(false);
+    }
+    catch (const runtime_error&) {
+    }
+    assert(search_server.GetDocumentCount() == 2);
+}
+void TestSegmentsWithIdReuse() {
+    {
+        SearchServer search_server("and in on"s);
+        search_server.AddDocument(5, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+        search_server.FlushSegment();
+        search_server.RemoveDocument(5);
+        search_server.AddDocument(5, "fluffy cat"s, DocumentStatus::ACTUAL, { 2 });
+        search_server.FlushSegment();
+        search_server.RemoveDocument(5);
+        assert(search_server.FindTopDocuments("cat"s).empty());
+
+        search_server.AddDocument(5, "groomed cat"s, DocumentStatus::ACTUAL, { 3 });
+        search_server.FlushSegment();
+        const auto documents = search_server.FindTopDocuments("cat"s);
+        assert(documents.size() == 1 && documents[0].id == 5 && documents[0].rating == 3);
+        assert(search_server.FindTopDocuments("fluffy"s).empty());
+    }
+
+    //      id      
+    //   ,   ,     
+    mt19937 generator(17);
+    SearchServer search_server("w0"s);
+    map<int, string> live_documents;
+    for (int i = 0; i < 3000; ++i) {
+        const int document_id = uniform_int_distribution(0, 299)(generator);
+        if (live_documents.count(document_id) > 0) {
+            search_server.RemoveDocument(document_id);
+            live_documents.erase(document_id);
+        }
+        else {
+            string text;
+            for (int j = 0; j < 6; ++j) {
+                text += "w"s + to_string(uniform_int_distribution(0, 40)(generator)) + " "s;
+            }
+            search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, { document_id });
+            live_documents[document_id] = text;
+        }
+        if (i % 100 == 99) {
+            search_server.FlushSegment();
+        }
+    }
+
+    SearchServer reference_server("w0"s);
+    for (const auto& [document_id, text] : live_documents) {
+        reference_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, { document_id });
+    }
+    assert(search_server.GetDocumentCount() == reference_server.GetDocumentCount());
+
+    for (int word = 1; word <= 40; ++word) {
+        const string query = "w"s + to_string(word) + " w"s + to_string(word % 40 + 1) + " -w"s + to_string((word + 7) % 40 + 1);
+        const vector<Document> expected = reference_server.FindTopDocuments(query);
+        for (const vector<Document>& documents : { search_server.FindTopDocuments(query), ProcessQueries(search_server, { query })[0] }) {
+            assert(documents.size() == expected.size());
+            for (size_t i = 0; i < documents.size(); ++i) {
+                assert(documents[i].id == expected[i].id && abs(documents[i].relevance - expected[i].relevance) < ELIPSON);
+            }
+        }
+    }
+}
+void TestCorpusLoader() {
+    {
+        SearchServer search_server("and in on"s);
+        istringstream input("1\tACTUAL\t8 -3\twhite cat and fashionable collar\r\n"s
+            "x\tACTUAL\t1\tbad id\n"s
+            "2\tUNKNOWN\t1\tbad status\n"s
+            "\n"s
+            "3\tBANNED\t\tgroomed dog\n"s
+            "4\tACTUAL\t5 x\tbad rating\n"s
+            "1\tACTUAL\t1\tduplicate id\n"s
+            "5\tIRRELEVANT\t9\tfluffy tail"s);
+        const CorpusLoadStats stats = LoadCorpus(search_server, input, CorpusFormat::TSV);
+        assert(stats.document_count == 3 && stats.error_count == 4);
+        assert(search_server.GetDocumentContent(1) == "white cat and fashionable collar"s);
+        assert(search_server.FindTopDocuments("dog"s, DocumentStatus::BANNED).size() == 1);
+        assert(search_server.FindTopDocuments("tail"s, DocumentStatus::IRRELEVANT).size() == 1);
+    }
+    {
+        SearchServer search_server("and in on"s);
+        istringstream input(R"({"id": 1, "status": "ACTUAL", "ratings": [8, -3], "text": "white cat"})" "\n"
+            R"({"text": "say \"hi\" to c:\\dir and \u0063at \u00e9", "extra": {"nested": [1, "}"]}, "id": 2})" "\r\n"
+            R"({"id": 3, "text": "broken escape \x"})" "\n"
+            R"({"id": 4, "ratings": [1,], "text": "bad array"})" "\n"
+            R"({"text": "no id"})" "\n"
+            R"(not json)" "\n"
+            R"({"id": 5, "status": "BANNED", "text": "last line"})");
+        const CorpusLoadStats stats = LoadCorpus(search_server, input, CorpusFormat::JSONL);
+        assert(stats.document_count == 3 && stats.error_count == 4);
+        assert(search_server.GetDocumentContent(2) == "say \"hi\" to c:\\dir and cat \xC3\xA9"s);
+        assert(search_server.FindTopDocuments("cat"s).size() == 2);
+        assert(search_server.FindTopDocuments("line"s, DocumentStatus::BANNED).size() == 1);
+    }
+    {
+        //          
+        SearchServer search_server("and in on"s);
+        string corpus = "1\tACTUAL\t1\t"s + string(CORPUS_CHUNK_SIZE - 20, 'a') + "\n"s;
+        corpus += "2\tACTUAL\t7\tfluffy cat tail\n"s;
+        corpus += "3\tACTUAL\t5\tgroomed dog\n"s;
+        istringstream input(corpus);
+        const CorpusLoadStats stats = LoadCorpus(search_server, input, CorpusFormat::TSV);
+        assert(stats.document_count == 3 && stats.error_count == 0 && stats.byte_count == corpus.size());
+        const auto documents = search_server.FindTopDocuments("fluffy"s);
+        assert(documents.size() == 1 && documents[0].id == 2 && documents[0].rating == 7);
+    }
+}
+//         
+struct CollidingHash {
+    size_t operator()(int) const {
+        return 0;
+    }
+};
+void TestConcurrentMap() {
+    {
+        //       
+        ConcurrentMap<int, int, CollidingHash> concurrent_map(4);
+        for (int key = 0; key < 20; ++key) {
+            concurrent_map[key].ref_to_value = key * 10;
+        }
+        for (int key = 0; key < 20; key += 2) {
+            concurrent_map.erase(key);
+        }
+        concurrent_map.erase(100);
+        for (int key = 0; key < 20; ++key) {
+            assert(key % 2 == 0 ? !concurrent_map.Get(key) : concurrent_map.Get(key) == key * 10);
+        }
+        for (int key = 0; key < 20; key += 2) {
+            concurrent_map[key].ref_to_value = key;
+        }
+        for (int key = 0; key < 20; ++key) {
+            assert(concurrent_map.Get(key) == (key % 2 == 0 ? key : key * 10));
+        }
+    }
+    {
+        ConcurrentMap<string_view, int, hash<string_view>, shared_mutex> concurrent_map(8);
+        for (string_view word : SplitIntoWords("white cat and fluffy cat and groomed dog"sv)) {
+            ++concurrent_map[word].ref_to_value;
+        }
+        assert(concurrent_map.Get("cat"sv) == 2 && concurrent_map.Get("dog"sv) == 1 && !concurrent_map.Get("rat"sv));
+        assert((concurrent_map.BuildOrdinaryMap() == map<string_view, int>{ { "and"sv, 2 }, { "cat"sv, 2 }, { "dog"sv, 1 },
+            { "fluffy"sv, 1 }, { "groomed"sv, 1 }, { "white"sv, 1 } }));
+    }
+    {
+        mt19937 generator(31);
+        ConcurrentMap<int, int> concurrent_map(16);
+        map<int, int> expected;
+        for (int i = 0; i < 100'000; ++i) {
+            const int key = uniform_int_distribution(0, 4999)(generator);
+            if (i % 3 == 0) {
+                concurrent_map.erase(key);
+                expected.erase(key);
+            }
+            else {
+                concurrent_map[key].ref_to_value += i;
+                expected[key] += i;
+            }
+        }
+        assert(concurrent_map.BuildOrdinaryMap() == expected);
+
+        vector<atomic_int> visit_counts(5000);
+        concurrent_map.ForEach(execution::par,
+            [&visit_counts, &expected](int key, int value) {
+                assert(expected.at(key) == value);
+                ++visit_counts[key];
+            });
+        for (int key = 0; key < 5000; ++key) {
+            assert(visit_counts[key] == static_cast<int>(expected.count(key)));
+        }
+    }
+}
+void TestQueryParsingDoesNotAllocate() {
+    SearchServer search_server("in the on"s);
+    search_server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    const string query = "fluffy dog -rat in the old -shed on sunny day"s;
+    const size_t allocation_count_before = allocation_count;
+    const auto documents = search_server.FindTopDocuments(query);
+    assert(documents.empty());
+    assert(allocation_count == allocation_count_before);
+
+    //  :      
+    const auto count_parse_allocations = [&search_server](const string& raw_query) {
+        const size_t allocation_count_before = allocation_count;
+        const SearchServer::Query query = search_server.ParseQuery(raw_query);
+        return allocation_count - allocation_count_before;
+    };
+    assert(count_parse_allocations("white cat -collar in the -fashionable on"s) == 0);
+
+    // QUERY_INLINE_WORD_COUNT      
+    string long_query;
+    for (size_t i = 0; i <= QUERY_INLINE_WORD_COUNT; ++i) {
+        long_query += "white cat -collar "s;
+    }
+    assert(count_parse_allocations(long_query) > 0);
+}
+void TestQueryPlan() {
+    SearchServer search_server("in the"s);
+    for (int id = 0; id < 12000; ++id) {
+        search_server.AddDocument(id, id % 100 == 0 ? "rare cat dog bird"s : "cat dog bird"s, DocumentStatus::ACTUAL, { 1 });
+    }
+
+    const auto plan_words = [](const vector<QueryPlan::Word>& words) {
+        vector<string_view> result;
+        for (const QueryPlan::Word& word : words) {
+            result.push_back(word.data);
+        }
+        return result;
+    };
+
+    //     ,      
+    // :   , - ,    
+    {
+        const string query = "cat rare -dog"s;
+        const QueryPlan plan = search_server.PlanQuery(query);
+        assert((plan_words(plan.plus_words) == vector<string_view>{ "rare"sv, "cat"sv }));
+        assert(plan.plus_posting_count == 12120);
+        assert(plan.minus_posting_count == 12000);
+        assert(plan.are_minus_words_first);
+    }
+    {
+        const string query = "rare -dog -unknown"s;
+        const QueryPlan plan = search_server.PlanQuery(query);
+        assert(plan_words(plan.minus_words) == vector<string_view>{ "dog"sv });
+        assert(!plan.are_minus_words_first);
+        assert(!plan.is_parallel);
+    }
+
+    //      ,      
+    {
+        const QueryPlan plan = search_server.PlanQuery("bird cat dog rare"s);
+        const size_t thread_count = max(thread::hardware_concurrency(), 1u);
+        assert(plan.is_parallel == (thread_count >= 2));
+        if (plan.is_parallel) {
+            assert(plan.word_groups.size() == min<size_t>(thread_count, 3));
+            vector<int> word_counts(plan.plus_words.size());
+            for (const vector<size_t>& group : plan.word_groups) {
+                assert(!group.empty());
+                for (size_t word_index : group) {
+                    ++word_counts[word_index];
+                }
+            }
+            assert(word_counts == vector<int>(plan.plus_words.size(), 1));
+        }
+        else {
+            assert(plan.word_groups.empty());
+        }
+    }
+
+    // seq  par     
+    const auto traced_words = [](const QueryTrace& trace) {
+        vector<string> result;
+        for (const QueryTrace::Word& word : trace.plus_words) {
+            result.push_back(word.data);
+        }
+        return result;
+    };
+    const vector<string> query_order = { "cat"s, "rare"s };
+    QueryTrace trace;
+    const auto seq_documents = search_server.FindTopDocuments(execution::seq, "rare cat"s, trace);
+    assert(traced_words(trace) == query_order);
+    assert(!trace.is_parallel);
+    const auto par_documents = search_server.FindTopDocuments(execution::par, "rare cat"s, trace);
+    assert(traced_words(trace) == query_order);
+    search_server.FindTopDocuments(automatic_policy, "rare cat"s, trace);
+    assert((traced_words(trace) == vector<string>{ "rare"s, "cat"s }));
+    assert(seq_documents.size() == par_documents.size());
+    for (size_t i = 0; i < seq_documents.size(); ++i) {
+        assert(seq_documents[i].id == par_documents[i].id);
+    }
+
+    //MatchDocument  automatic_policy  id   
+    try {
+        search_server.MatchDocument(automatic_policy, "cat -"s, 12000);
+        assert(false);
+    }
+    catch (const out_of_range&) {
+    }
+    const string match_query = "rare cat -fish"s;
+    const auto [matched_words, status] = search_server.MatchDocument(automatic_policy, match_query, 100);
+    assert((matched_words == vector<string_view>{ "cat"sv, "rare"sv }));
+    assert(status == DocumentStatus::ACTUAL);
+}
+void TestDuplicateDetection() {
+    //  :   id      
+    const auto find_duplicates_by_scan = [](SearchServer& search_server) {
+        vector<int> duplicate_ids;
+        set<set<string_view>> word_sets;
+        for (const int document_id : search_server) {
+            set<string_view> word_set;
+            for (const auto& [word, freq] : search_server.GetWordFrequencies(document_id)) {
+                word_set.insert(word);
+            }
+            if (!word_sets.insert(word_set).second) {
+                duplicate_ids.push_back(document_id);
+            }
+        }
+        return duplicate_ids;
+    };
+
+    //    , id  
+    {
+        mt19937 generator(29);
+        SearchServer search_server("and"s);
+        set<int> live_ids;
+        for (int i = 0; i < 2000; ++i) {
+            const int document_id = uniform_int_distribution(0, 199)(generator);
+            if (live_ids.count(document_id) > 0) {
+                search_server.RemoveDocument(document_id);
+                live_ids.erase(document_id);
+            }
+            else {
+                string text = "and"s;
+                const int word_count = uniform_int_distribution(1, 3)(generator);
+                for (int j = 0; j < word_count; ++j) {
+                    text += " w"s + to_string(uniform_int_distribution(0, 4)(generator));
+                }
+                search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, { 1 });
+                live_ids.insert(document_id);
+            }
+            if (i % 100 == 99) {
+                assert(search_server.GetDuplicateIds() == find_duplicates_by_scan(search_server));
+            }
+        }
+        assert(!search_server.GetDuplicateIds().empty());
+    }
+
+    //        id 
+    {
+        SearchServer search_server(""s);
+        search_server.AddDocument(6, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+        search_server.AddDocument(2, "cat white"s, DocumentStatus::ACTUAL, { 1 });
+        search_server.AddDocument(4, "white cat cat"s, DocumentStatus::ACTUAL, { 1 });
+        search_server.AddDocument(3, "black cat"s, DocumentStatus::ACTUAL, { 1 });
+        assert((search_server.GetDuplicateIds() == vector<int>{ 4, 6 }));
+        search_server.RemoveDocument(2);
+        assert(search_server.GetDuplicateIds() == vector<int>{ 6 });
+        search_server.RemoveDocument(4);
+        assert(search_server.GetDuplicateIds().empty());
+        search_server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+        assert(search_server.GetDuplicateIds() == vector<int>{ 6 });
+    }
+
+    //REJECT:    id ,      
+    {
+        SearchServer search_server(""s);
+        search_server.SetDuplicatePolicy(DuplicatePolicy::REJECT);
+        search_server.AddDocument(5, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+        try {
+            search_server.AddDocument(7, "cat white"s, DocumentStatus::ACTUAL, { 1 });
+            assert(false);
+        }
+        catch (const invalid_argument& e) {
+            assert(e.what() == "Document duplicates document 5"s);
+        }
+        assert(search_server.GetDocumentCount() == 1);
+
+        search_server.AddDocument(3, "white white cat"s, DocumentStatus::ACTUAL, { 2 });
+        assert(search_server.GetDocumentCount() == 1);
+        assert(search_server.GetDuplicateIds().empty());
+        const auto documents = search_server.FindTopDocuments("cat"s);
+        assert(documents.size() == 1 && documents[0].id == 3 && documents[0].rating == 2);
+        try {
+            search_server.MatchDocument("cat"s, 5);
+            assert(false);
+        }
+        catch (const out_of_range&) {
+        }
+
+        search_server.SetDuplicatePolicy(DuplicatePolicy::ALLOW);
+        search_server.AddDocument(7, "cat white"s, DocumentStatus::ACTUAL, { 1 });
+        assert(search_server.GetDuplicateIds() == vector<int>{ 7 });
+    }
+}
+void TestQueryDeadline() {
+    SearchServer search_server("in the on"s);
+    search_server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    const string query = "fluffy cat"s;
+
+    const SearchResult complete = search_server.FindTopDocuments(query, QueryDeadline(chrono::hours(1)));
+    assert(!complete.is_partial);
+    assert(complete.documents.size() == 2);
+
+    const SearchResult expired = search_server.FindTopDocuments(query, QueryDeadline(chrono::steady_clock::now()));
+    assert(expired.is_partial);
+    assert(expired.documents.empty());
+
+    CancellationToken cancellation_token;
+    cancellation_token.Cancel();
+    for (const SearchResult& result : ProcessQueries(search_server, { query, query }, QueryDeadline(cancellation_token))) {
+        assert(result.is_partial);
+    }
+    assert(search_server.GetDeadlineMissCount() == 3);
+}
+void TestDocumentStorage() {
+    const string text = "fluffy cat fluffy tail"s;
+    for (DocumentStorage storage : { DocumentStorage::FULL, DocumentStorage::COMPRESSED, DocumentStorage::NONE }) {
+        SearchServer search_server("in the on"s);
+        search_server.SetDocumentStorage(storage);
+        search_server.AddDocument(1, text, DocumentStatus::ACTUAL, { 7, 2, 7 });
+        assert(search_server.GetWordFrequencies(1).at("fluffy"sv) == 0.5);
+        assert(search_server.GetDocumentContent(1) == (storage == DocumentStorage::NONE ? nullopt : optional(text)));
+    }
+    assert(DecompressText(CompressText(text + text + text)) == text + text + text);
+}
+void TestPrefixQuery() {
+    SearchServer search_server("in the on"s);
+    search_server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+    search_server.AddDocument(4, "catalogue of collars"s, DocumentStatus::ACTUAL, { 9 });
+
+    const auto [words, status] = search_server.MatchDocument("cat* -dog"s, 4);
+    assert(words == vector<string_view>{ "catalogue"sv });
+    assert(search_server.FindTopDocuments("coll*"s).size() == 2);
+    assert(search_server.FindTopDocuments("cat* -fluff*"s).size() == 2);
+    assert(search_server.FindTopDocuments("zebra*"s).empty());
+    try {
+        search_server.FindTopDocuments("-*"s);
+        assert(false);
+    }
+    catch (const invalid_argument&) {
+    }
+}
+void TestPhraseQuery() {
+    SearchServer search_server("in the on"s);
+    search_server.SetPositionIndexing(true);
+    search_server.AddDocument(1, "white cat in the city"s, DocumentStatus::ACTUAL, { 8, -3 });
+    search_server.AddDocument(2, "city cat white collar"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(3, "white fluffy old cat"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+
+    assert(search_server.FindTopDocuments("\"white cat\""s).size() == 1);
+    assert(search_server.FindTopDocuments("\"cat in the city\""s).size() == 1);
+    assert(search_server.FindTopDocuments("white -\"white cat\""s).size() == 2);
+    assert(search_server.FindTopDocuments("white NEAR/2 cat"s).size() == 2);
+    assert(search_server.FindTopDocuments("white NEAR/3 cat"s).size() == 3);
+    //       
+    assert(search_server.FindTopDocuments("cat NEAR/1 cat"s).empty());
+    assert(search_server.FindTopDocuments("cat NEAR/5 cat"s).empty());
+    const auto [words, status] = search_server.MatchDocument("\"white cat\" city"s, 2);
+    assert(words.empty());
+    for (const string& query : { "\"white cat"s, "NEAR/2 cat"s, "white NEAR/0 cat"s, "\"white -cat\""s }) {
+        try {
+            search_server.FindTopDocuments(query);
+            assert(false);
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+
+    //-     ,    
+    search_server.AddDocument(4, "black cat in the house"s, DocumentStatus::ACTUAL, { 1 });
+    assert(search_server.FindTopDocuments("\"black house\""s).empty());
+    assert(search_server.FindTopDocuments("\"cat in house\""s).empty());
+    assert(search_server.FindTopDocuments("\"cat on the house\""s).size() == 1);
+    assert(search_server.FindTopDocuments("black NEAR/3 house"s).empty());
+    assert(search_server.FindTopDocuments("black NEAR/4 house"s).size() == 1);
+    search_server.AddDocument(5, "cat and cat"s, DocumentStatus::ACTUAL, { 1 });
+    assert(search_server.FindTopDocuments("cat NEAR/1 cat"s).empty());
+    const auto cat_documents = search_server.FindTopDocuments("cat NEAR/2 cat"s);
+    assert(cat_documents.size() == 1 && cat_documents[0].id == 5);
+
+    //    ,   NEAR/k ,     
+    search_server.SetPositionIndexing(false);
+    search_server.AddDocument(6, "black cat"s, DocumentStatus::ACTUAL, { 1 });
+    for (const string& query : { "\"black cat\""s, "black NEAR/1 cat"s, "black -\"black cat\""s }) {
+        try {
+            search_server.FindTopDocuments(query);
+            assert(false);
+        }
+        catch (const invalid_argument&) {
+        }
+        try {
+            search_server.MatchDocument(query, 4);
+            assert(false);
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+    assert(search_server.FindTopDocuments("black -cat"s).empty());
+    search_server.RemoveDocument(6);
+    assert(search_server.FindTopDocuments("black -\"black cat\""s).empty());
+    assert(search_server.FindTopDocuments("\"black cat\""s).size() == 1);
+}
+void TestQueryTrace() {
+    SearchServer search_server("in the on"s);
+    search_server.AddDocument(1, "white cat in the city"s, DocumentStatus::ACTUAL, { 8, -3 });
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, { 5, -12, 2, 1 });
+    search_server.AddDocument(4, "fluffy dog and cat"s, DocumentStatus::ACTUAL, { 9 });
+
+    QueryTrace trace;
+    assert(search_server.FindTopDocuments(execution::par, "fluffy cat dog in -tail"s, trace).size() == 2);
+    assert(trace.plus_words.size() == 3 && trace.minus_words.size() == 1 && trace.minus_words[0].posting_count == 1);
+    assert(trace.stop_words.size() == 1 && trace.stop_words[0] == "in"s);
+    assert(trace.is_parallel && !trace.is_partial);
+    assert(trace.scored_document_count == 3 && trace.minus_excluded_document_count == 1);
+    assert(trace.predicate_excluded_document_count == 1 && trace.result_document_count == 2);
+    assert(trace.total_time >= trace.parse_time + trace.traversal_time + trace.filter_time + trace.sort_time);
+
+    //        ,   
+    search_server.FindTopDocuments("fluffy zebra* -dog -unknown"s, trace);
+    assert(trace.plus_words.size() == 2 && trace.plus_words[1].data == "zebra*"s && trace.plus_words[1].posting_count == 0);
+    assert(trace.minus_words.size() == 2 && trace.minus_words[1].data == "unknown"s && trace.minus_words[1].posting_count == 0);
+
+    //-  -,   2    ,      
+    search_server.FindTopDocuments(automatic_policy, "fluffy cat dog in -tail"s, trace);
+    assert(!trace.is_parallel && trace.scored_document_count == 2 && trace.minus_excluded_document_count == 1);
+
+    const auto [words, status] = search_server.MatchDocument("fluffy -tail"s, 2, trace);
+    assert(words.empty() && trace.scored_document_count == 1 && trace.minus_excluded_document_count == 1);
+
+    SlowQueryLog slow_query_log(2);
+    for (int milliseconds : { 1, 3, 2 }) {
+        QueryTrace slow_trace;
+        slow_trace.total_time = chrono::milliseconds(milliseconds);
+        slow_query_log.Add(slow_trace);
+    }
+    const vector<QueryTrace> traces = slow_query_log.GetTraces();
+    assert(traces.size() == 2 && traces[0].total_time == chrono::milliseconds(3) && traces[1].total_time == chrono::milliseconds(2));
+
+    slow_query_log.Clear();
+    search_server.SetSlowQueryLog(&slow_query_log);
+    search_server.FindTopDocuments("white cat"s);
+    search_server.SetSlowQueryLog(nullptr);
+    assert(slow_query_log.GetTraces().size() == 1 && slow_query_log.GetTraces()[0].raw_query == "white cat"s);
+}
 string GenerateWord(mt19937& generator, int max_length) {
     const int length = uniform_int_distribution(1, max_length)(generator);
     string word;
@@ -37,11 +649,11 @@ string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int w
     }
     return query;
 }
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
+vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count, double minus_prob = 0) {
     vector<string> queries;
     queries.reserve(query_count);
     for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+        queries.push_back(GenerateQuery(generator, dictionary, max_word_count, minus_prob));
     }
     return queries;
 }
@@ -57,7 +669,128 @@ void Test(string_view mark, const SearchServer& search_server, const vector<stri
     cout << total_relevance << endl;
 }
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
+//   ConcurrentMap: std::map  ,    
+template <typename Key, typename Value>
+class StdMapConcurrentMap {
+public:
+    struct Bucket {
+        mutex m_;
+        map<Key, Value> bucket_;
+    };
+    struct Access {
+        lock_guard<mutex> guard;
+        Value& ref_to_value;
+        Access(const Key& key, Bucket& bucket)
+            : guard(bucket.m_), ref_to_value(bucket.bucket_[key]) {
+        }
+    };
+    explicit StdMapConcurrentMap(size_t bucket_count)
+        : segments_(bucket_count) {
+    }
+    Access operator[](const Key& key) {
+        return { key, segments_[static_cast<uint64_t>(key) % segments_.size()] };
+    }
+private:
+    vector<Bucket> segments_;
+};
+template <typename ConcurrentMapType>
+void BenchmarkConcurrentMap(string_view mark, int thread_count) {
+    const int operation_count = 1'000'000;
+    const int key_count = 10'000;
+    ConcurrentMapType concurrent_map(32);
+    LOG_DURATION(string(mark) + ", threads = "s + to_string(thread_count));
+    vector<thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&concurrent_map, i, thread_count] {
+            mt19937 generator(i);
+            for (int j = 0; j < operation_count / thread_count; ++j) {
+                concurrent_map[uniform_int_distribution(0, key_count - 1)(generator)].ref_to_value += 1;
+            }
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+}
+void BenchmarkConcurrentMaps() {
+    for (int thread_count = 1; thread_count <= 64; thread_count *= 2) {
+        BenchmarkConcurrentMap<StdMapConcurrentMap<int, int>>("std::map buckets"sv, thread_count);
+        BenchmarkConcurrentMap<ConcurrentMap<int, int>>("open addressing buckets"sv, thread_count);
+    }
+}
+void BenchmarkProcessQueries(const SearchServer& search_server, const vector<string>& queries) {
+    vector<vector<Document>> expected(queries.size());
+    {
+        LOG_DURATION("per-query ProcessQueries"sv);
+        transform(execution::par, queries.begin(), queries.end(), expected.begin(),
+            [&search_server](const string& query) {
+                return search_server.FindTopDocuments(query);
+            });
+    }
+    vector<vector<Document>> result;
+    {
+        LOG_DURATION("batch ProcessQueries"sv);
+        result = ProcessQueries(search_server, queries);
+    }
+    assert(result.size() == expected.size());
+    for (size_t i = 0; i < result.size(); ++i) {
+        assert(result[i].size() == expected[i].size());
+        for (size_t j = 0; j < result[i].size(); ++j) {
+            assert(result[i][j].id == expected[i][j].id);
+            assert(result[i][j].relevance == expected[i][j].relevance);
+            assert(result[i][j].rating == expected[i][j].rating);
+        }
+    }
+}
+void BenchmarkPhraseQueries(mt19937& generator, const vector<string>& stop_words, const vector<string>& documents) {
+    SearchServer search_server(stop_words[0]);
+    search_server.SetPositionIndexing(true);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+    }
+    cout << search_server.GetMemoryUsage() << endl;
+
+    //           
+    vector<string> phrase_queries;
+    vector<string> word_queries;
+    for (int i = 0; i < 1'000; ++i) {
+        const vector<string_view> words = SplitIntoWords(documents[uniform_int_distribution<size_t>(0, documents.size() - 1)(generator)]);
+        const size_t begin = uniform_int_distribution<size_t>(0, words.size() - 3)(generator);
+        const string text = string(words[begin]) + " "s + string(words[begin + 1]) + " "s + string(words[begin + 2]);
+        phrase_queries.push_back("\""s + text + "\""s);
+        word_queries.push_back(text);
+    }
+
+    size_t phrase_document_count = 0;
+    {
+        LOG_DURATION("phrase queries"sv);
+        for (const string& query : phrase_queries) {
+            phrase_document_count += search_server.FindTopDocuments(query).size();
+        }
+    }
+    size_t word_document_count = 0;
+    {
+        LOG_DURATION("word queries"sv);
+        for (const string& query : word_queries) {
+            word_document_count += search_server.FindTopDocuments(query).size();
+        }
+    }
+    cout << phrase_document_count << " " << word_document_count << endl;
+}
 int main() {
+    TestMatchDocuments();
+    TestMemoryBudget();
+    TestSegmentsWithIdReuse();
+    TestCorpusLoader();
+    TestConcurrentMap();
+    TestQueryParsingDoesNotAllocate();
+    TestQueryPlan();
+    TestDuplicateDetection();
+    TestQueryDeadline();
+    TestDocumentStorage();
+    TestPrefixQuery();
+    TestPhraseQuery();
+    TestQueryTrace();
     mt19937 generator;
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
     const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
@@ -68,4 +801,15 @@ int main() {
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
     TEST(seq);
     TEST(par);
+    Test("auto"sv, search_server, queries, automatic_policy);
+    {
+        SlowQueryLog slow_query_log(3);
+        search_server.SetSlowQueryLog(&slow_query_log);
+        Test("traced auto"sv, search_server, queries, automatic_policy);
+        search_server.SetSlowQueryLog(nullptr);
+        cout << slow_query_log.GetTraces().front() << endl;
+    }
+    BenchmarkProcessQueries(search_server, GenerateQueries(generator, dictionary, 1'000, 10, 0.1));
+    BenchmarkPhraseQueries(generator, dictionary, documents);
+    BenchmarkConcurrentMaps();
 }
\ No newline at end of file
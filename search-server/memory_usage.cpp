@@ -0,0 +1,35 @@
+#include "memory_usage.h"
+
+using namespace std;
+
+size_t MemoryUsage::Total() const {
+    return documents + content + word_freqs + forward_index + word_to_document_freqs
+        + document_ids + dictionary + segments + stop_words + duplicates + positions;
+}
+
+ostream& operator<<(ostream& output, const MemoryUsage& memory_usage) {
+    output << "{ "s
+           << "documents = "s << memory_usage.documents << ", "s
+           << "content = "s << memory_usage.content << ", "s
+           << "word_freqs = "s << memory_usage.word_freqs << ", "s
+           << "forward_index = "s << memory_usage.forward_index << ", "s
+           << "word_to_document_freqs = "s << memory_usage.word_to_document_freqs << ", "s
+           << "document_ids = "s << memory_usage.document_ids << ", "s
+           << "dictionary = "s << memory_usage.dictionary << ", "s
+           << "segments = "s << memory_usage.segments << ", "s
+           << "stop_words = "s << memory_usage.stop_words << ", "s
+           << "duplicates = "s << memory_usage.duplicates << ", "s
+           << "positions = "s << memory_usage.positions << ", "s
+           << "total = "s << memory_usage.Total() << " }"s;
+
+    return output;
+}
+
+size_t GetHeapSize(const string& str) {
+    const char* data = str.data();
+    const char* object = reinterpret_cast<const char*>(&str);
+    if (data >= object && data < object + sizeof(str)) {
+        return 0;
+    }
+    return str.capacity() + 1;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//   - :    
+const size_t TREE_NODE_OVERHEAD = 4 * sizeof(void*);
+//   std::unordered_map:       
+const size_t HASH_NODE_OVERHEAD = sizeof(void*) + sizeof(size_t);
+
+struct MemoryUsage {
+    size_t documents = 0;
+    size_t content = 0;
+    size_t word_freqs = 0;
+    size_t forward_index = 0;
+    size_t word_to_document_freqs = 0;
+    size_t document_ids = 0;
+    size_t dictionary = 0;
+    size_t segments = 0;
+    size_t stop_words = 0;
+    size_t duplicates = 0;
+    size_t positions = 0;
+
+    size_t Total() const;
+};
+
+std::ostream& operator<<(std::ostream& output, const MemoryUsage& memory_usage);
+
+//   std::map/std::set    
+template <typename ValueType>
+constexpr size_t GetTreeNodeSize() {
+    const size_t size = TREE_NODE_OVERHEAD + sizeof(ValueType);
+    return (size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+}
+
+template <typename ValueType>
+constexpr size_t GetHashNodeSize() {
+    const size_t size = HASH_NODE_OVERHEAD + sizeof(ValueType);
+    return (size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+}
+
+//     (SSO)    
+size_t GetHeapSize(const std::string& str);
+
+template <typename Type>
+size_t GetHeapSize(const std::vector<Type>& vec) {
+    return vec.capacity() * sizeof(Type);
+}
@@ -6,14 +6,22 @@ std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
 
-    std::vector<std::vector<Document>> result(queries.size());
+    return search_server.FindTopDocumentsBatch(queries);
+}
+
+std::vector<SearchResult> ProcessQueries(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    const QueryDeadline& deadline) {
+
+    std::vector<SearchResult> result(queries.size());
 
     transform(
         std::execution::par,
         queries.begin(), queries.end(),
         result.begin(),
-        [&search_server](const std::string& query) {
-            return search_server.FindTopDocuments(query);
+        [&search_server, &deadline](const std::string& query) {
+            return search_server.FindTopDocuments(query, deadline);
         }
     );
 
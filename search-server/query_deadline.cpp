@@ -0,0 +1,40 @@
+#include "query_deadline.h"
+
+using namespace std;
+
+CancellationToken::CancellationToken()
+    : is_cancelled_(make_shared<atomic_bool>(false)) {
+}
+
+void CancellationToken::Cancel() const {
+    is_cancelled_->store(true, memory_order_relaxed);
+}
+
+bool CancellationToken::IsCancelled() const {
+    return is_cancelled_->load(memory_order_relaxed);
+}
+
+QueryDeadline::QueryDeadline(chrono::steady_clock::time_point deadline)
+    : deadline_(deadline) {
+}
+
+QueryDeadline::QueryDeadline(chrono::steady_clock::duration timeout)
+    : deadline_(chrono::steady_clock::now() + timeout) {
+}
+
+QueryDeadline::QueryDeadline(CancellationToken cancellation_token)
+    : cancellation_token_(move(cancellation_token)) {
+}
+
+QueryDeadline::QueryDeadline(chrono::steady_clock::time_point deadline, CancellationToken cancellation_token)
+    : deadline_(deadline)
+    , cancellation_token_(move(cancellation_token)) {
+}
+
+bool QueryDeadline::IsExpired() const {
+    if (cancellation_token_ && cancellation_token_->IsCancelled()) {
+        return true;
+    }
+
+    return deadline_ && chrono::steady_clock::now() >= *deadline_;
+}
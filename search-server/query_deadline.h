@@ -0,0 +1,45 @@
+#pragma once
+#include "document.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+
+//        
+const size_t DEADLINE_CHECK_POSTING_COUNT = 1024;
+
+//    :       
+class CancellationToken {
+public:
+    CancellationToken();
+
+    void Cancel() const;
+    bool IsCancelled() const;
+
+private:
+    std::shared_ptr<std::atomic_bool> is_cancelled_;
+};
+
+class QueryDeadline {
+public:
+    //  
+    QueryDeadline() = default;
+    explicit QueryDeadline(std::chrono::steady_clock::time_point deadline);
+    explicit QueryDeadline(std::chrono::steady_clock::duration timeout);
+    explicit QueryDeadline(CancellationToken cancellation_token);
+    QueryDeadline(std::chrono::steady_clock::time_point deadline, CancellationToken cancellation_token);
+
+    bool IsExpired() const;
+
+private:
+    std::optional<std::chrono::steady_clock::time_point> deadline_;
+    std::optional<CancellationToken> cancellation_token_;
+};
+
+struct SearchResult {
+    std::vector<Document> documents;
+    // :        ,    
+    bool is_partial = false;
+};
@@ -0,0 +1,35 @@
+#include "query_plan.h"
+
+using namespace std;
+
+namespace {
+
+void PrintWords(ostream& output, const vector<QueryPlan::Word>& words) {
+    output << "["s;
+    bool is_first = true;
+    for (const QueryPlan::Word& word : words) {
+        if (!is_first) {
+            output << ", "s;
+        }
+        is_first = false;
+        output << word.data << ": "s << word.posting_count;
+    }
+    output << "]"s;
+}
+
+} // namespace
+
+ostream& operator<<(ostream& output, const QueryPlan& plan) {
+    output << "{ plus_words = "s;
+    PrintWords(output, plan.plus_words);
+    output << ", minus_words = "s;
+    PrintWords(output, plan.minus_words);
+    output << ", plus_postings = "s << plan.plus_posting_count
+           << ", minus_postings = "s << plan.minus_posting_count
+           << ", minus_words_first = "s << (plan.are_minus_words_first ? "true"s : "false"s)
+           << ", execution = "s << (plan.is_parallel ? "par"s : "seq"s)
+           << ", tasks = "s << (plan.is_parallel ? plan.word_groups.size() : 1)
+           << ", constraints = "s << plan.constraints.size() << " }"s;
+
+    return output;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+// ,         
+struct AutomaticPolicy {
+};
+
+inline constexpr AutomaticPolicy automatic_policy{};
+
+//   ,     
+const size_t PARALLEL_QUERY_MIN_POSTING_COUNT = 20000;
+//      
+const size_t PARALLEL_QUERY_POSTINGS_PER_TASK = 10000;
+// MatchDocument  RemoveDocument     
+const size_t PARALLEL_MIN_WORD_COUNT = 1000;
+// MatchDocuments    
+const size_t PARALLEL_MATCH_MIN_DOCUMENT_COUNT = 64;
+
+//     :   NEAR/k
+struct PositionConstraint {
+    //-1     
+    std::vector<int> word_ids;
+    //       , -    
+    std::vector<uint32_t> offsets;
+    // NEAR/k  k;    
+    size_t max_distance = 0;
+    //       , NEAR/k      k   
+    bool is_phrase = true;
+    //,   , 
+    bool is_minus = false;
+};
+
+struct QueryPlan {
+    struct Word {
+        std::string_view data;
+        int id;
+        size_t posting_count;
+    };
+
+    //    ,    
+    std::vector<Word> plus_words;
+    std::vector<Word> minus_words;
+    size_t plus_posting_count = 0;
+    size_t minus_posting_count = 0;
+
+    //  -    ,   
+    bool are_minus_words_first = false;
+    bool is_parallel = false;
+    // plus_words,    
+    std::vector<std::vector<size_t>> word_groups;
+    //   ,    
+    std::vector<PositionConstraint> constraints;
+};
+
+std::ostream& operator<<(std::ostream& output, const QueryPlan& plan);
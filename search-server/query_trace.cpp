@@ -0,0 +1,107 @@
+#include "query_trace.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+void PrintWords(ostream& output, const vector<QueryTrace::Word>& words) {
+    output << "["s;
+    bool is_first = true;
+    for (const QueryTrace::Word& word : words) {
+        if (!is_first) {
+            output << ", "s;
+        }
+        is_first = false;
+        output << word.data << ": "s << word.posting_count;
+    }
+    output << "]"s;
+}
+
+long long ToMicroseconds(chrono::steady_clock::duration duration) {
+    return chrono::duration_cast<chrono::microseconds>(duration).count();
+}
+
+bool IsFaster(const QueryTrace& lhs, const QueryTrace& rhs) {
+    return lhs.total_time < rhs.total_time;
+}
+
+bool IsSlower(const QueryTrace& lhs, const QueryTrace& rhs) {
+    return IsFaster(rhs, lhs);
+}
+
+} // namespace
+
+ostream& operator<<(ostream& output, const QueryTrace& trace) {
+    output << "{ query = \""s << trace.raw_query << "\", plus_words = "s;
+    PrintWords(output, trace.plus_words);
+    output << ", minus_words = "s;
+    PrintWords(output, trace.minus_words);
+    output << ", stop_words = ["s;
+    for (size_t i = 0; i < trace.stop_words.size(); ++i) {
+        output << (i > 0 ? ", "s : ""s) << trace.stop_words[i];
+    }
+    output << "], execution = "s << (trace.is_parallel ? "par"s : "seq"s)
+           << ", partial = "s << (trace.is_partial ? "true"s : "false"s)
+           << ", scored = "s << trace.scored_document_count
+           << ", minus_excluded = "s << trace.minus_excluded_document_count
+           << ", predicate_excluded = "s << trace.predicate_excluded_document_count
+           << ", constraint_excluded = "s << trace.constraint_excluded_document_count
+           << ", results = "s << trace.result_document_count
+           << ", parse_us = "s << ToMicroseconds(trace.parse_time)
+           << ", traversal_us = "s << ToMicroseconds(trace.traversal_time)
+           << ", filter_us = "s << ToMicroseconds(trace.filter_time)
+           << ", sort_us = "s << ToMicroseconds(trace.sort_time)
+           << ", total_us = "s << ToMicroseconds(trace.total_time) << " }"s;
+
+    return output;
+}
+
+void TraceQueryPlan(const QueryPlan& plan, QueryTrace& trace) {
+    trace.plus_words.clear();
+    for (const QueryPlan::Word& word : plan.plus_words) {
+        trace.plus_words.push_back({ string(word.data), word.posting_count });
+    }
+    trace.minus_words.clear();
+    for (const QueryPlan::Word& word : plan.minus_words) {
+        trace.minus_words.push_back({ string(word.data), word.posting_count });
+    }
+    trace.is_parallel = plan.is_parallel;
+}
+
+SlowQueryLog::SlowQueryLog(size_t capacity)
+    : capacity_(capacity) {
+}
+
+void SlowQueryLog::Add(QueryTrace trace) {
+    lock_guard guard(mutex_);
+    if (traces_.size() < capacity_) {
+        traces_.push_back(move(trace));
+        push_heap(traces_.begin(), traces_.end(), IsSlower);
+    }
+    else if (capacity_ > 0 && IsSlower(trace, traces_.front())) {
+        pop_heap(traces_.begin(), traces_.end(), IsSlower);
+        traces_.back() = move(trace);
+        push_heap(traces_.begin(), traces_.end(), IsSlower);
+    }
+}
+
+vector<QueryTrace> SlowQueryLog::GetTraces() const {
+    vector<QueryTrace> traces;
+    {
+        lock_guard guard(mutex_);
+        traces = traces_;
+    }
+    sort(traces.begin(), traces.end(), IsSlower);
+    return traces;
+}
+
+size_t SlowQueryLog::GetCapacity() const {
+    return capacity_;
+}
+
+void SlowQueryLog::Clear() {
+    lock_guard guard(mutex_);
+    traces_.clear();
+}
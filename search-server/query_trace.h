@@ -0,0 +1,91 @@
+#pragma once
+#include "query_plan.h"
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//        
+struct QueryTrace {
+    struct Word {
+        std::string data;
+        size_t posting_count;
+    };
+
+    std::string raw_query;
+    //      :      ,
+    // ,    ,        
+    std::vector<Word> plus_words;
+    std::vector<Word> minus_words;
+    std::vector<std::string> stop_words;
+
+    bool is_parallel = false;
+    bool is_partial = false;
+
+    //,  ,  ,     
+    size_t scored_document_count = 0;
+    size_t minus_excluded_document_count = 0;
+    size_t predicate_excluded_document_count = 0;
+    size_t constraint_excluded_document_count = 0;
+    size_t result_document_count = 0;
+
+    std::chrono::steady_clock::duration parse_time{};
+    std::chrono::steady_clock::duration traversal_time{};
+    std::chrono::steady_clock::duration filter_time{};
+    std::chrono::steady_clock::duration sort_time{};
+    //  ,    :      .
+    //  SlowQueryLog    
+    std::chrono::steady_clock::duration total_time{};
+};
+
+std::ostream& operator<<(std::ostream& output, const QueryTrace& trace);
+
+//        
+void TraceQueryPlan(const QueryPlan& plan, QueryTrace& trace);
+
+//        Stop  .     
+class TraceStage {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TraceStage(QueryTrace* trace, Clock::duration QueryTrace::* stage)
+        : stage_(trace ? &(trace->*stage) : nullptr)
+        , start_time_(stage_ ? Clock::now() : Clock::time_point()) {
+    }
+
+    ~TraceStage() {
+        Stop();
+    }
+
+    void Stop() {
+        if (stage_) {
+            *stage_ += Clock::now() - start_time_;
+            stage_ = nullptr;
+        }
+    }
+
+private:
+    Clock::duration* stage_;
+    Clock::time_point start_time_;
+};
+
+// capacity   . Add     
+class SlowQueryLog {
+public:
+    explicit SlowQueryLog(size_t capacity);
+
+    void Add(QueryTrace trace);
+    //     
+    std::vector<QueryTrace> GetTraces() const;
+    size_t GetCapacity() const;
+    void Clear();
+
+private:
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    //      :    
+    std::vector<QueryTrace> traces_;
+};
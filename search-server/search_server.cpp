@@ -2,9 +2,35 @@
 #include <numeric>
 #include <cmath>
 #include <algorithm>
+#include <queue>
+#include <charconv>
 
 using namespace std;
 
+namespace {
+
+const string_view NEAR_OPERATOR_PREFIX = "NEAR/"sv;
+
+void WriteVarint(string& output, uint32_t value) {
+    for (; value >= 0x80; value >>= 7) {
+        output.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    }
+    output.push_back(static_cast<char>(value));
+}
+
+uint32_t ReadVarint(string_view input, size_t& pos) {
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        const unsigned char byte = static_cast<unsigned char>(input[pos++]);
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return value;
+        }
+    }
+}
+
+}
+
 SearchServer::SearchServer(const string& stop_words_text)
     : SearchServer(string_view(stop_words_text)) {
 }
@@ -13,6 +39,19 @@ SearchServer::SearchServer(string_view stop_words_text)
     :SearchServer(SplitIntoWords(stop_words_text)){
 }
 
+SearchServer::~SearchServer() {
+    if (!merge_thread_.joinable()) {
+        return;
+    }
+
+    {
+        lock_guard guard(merge_mutex_);
+        is_stopping_ = true;
+    }
+    merge_condition_.notify_one();
+    merge_thread_.join();
+}
+
 set<int>::iterator SearchServer::begin() {
     return document_ids_.begin();
 }
@@ -23,6 +62,19 @@ set<int>::iterator SearchServer::end() {
 
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
     const vector<int>& ratings) {
+    AddDocument(document_id, PrepareDocument(document), status, ratings);
+}
+
+SearchServer::PreparedDocument SearchServer::PrepareDocument(string_view document) const {
+    if (!(IsValidWord(document))) {
+        throw invalid_argument("Document text contains special characters"s);
+    }
+
+    return { document, SplitIntoWordsNoStop(document) };
+}
+
+void SearchServer::AddDocument(int document_id, const PreparedDocument& document, DocumentStatus status,
+    const vector<int>& ratings) {
 
     //
     if (documents_.count(document_id) > 0) {
@@ -31,26 +83,86 @@ void SearchServer::AddDocument(int document_id, string_view document, DocumentSt
     if (document_id < 0) {
         throw invalid_argument("Document ID is negative"s);
     }
-    if (!(IsValidWord(document))) {
-        throw invalid_argument("Document text contains special characters"s);
+    if (duplicate_policy_ == DuplicatePolicy::REJECT) {
+        const int original_id = FindDuplicateOriginal(document);
+        if (original_id >= 0 && original_id < document_id) {
+            throw invalid_argument("Document duplicates document "s + to_string(original_id));
+        }
+    }
+    if (memory_budget_ > 0 && GetCachedMemoryUsage().Total() + EstimateDocumentMemory(document) > memory_budget_) {
+        throw runtime_error("Memory budget exceeded"s);
     }
 
     document_ids_.insert(document_id);
     documents_.emplace(document_id, DocumentData{});
 
     //   
-    documents_[document_id].content = static_cast<string>(document);
+    document_store_.Add(document_id, document.text);
     documents_[document_id].rating = ComputeAverageRating(ratings);
     documents_[document_id].status = status;
 
+    //      ,
+    //    ,     
+    const double inv_word_count = 1.0 / document.words.size();
+    for (string_view word : document.words) {
+        documents_[document_id].word_freqs[terms_.GetTerm(GetWordId(word))] += inv_word_count;
+    }
 
-    //    (  -)
-    //string_view        
-    const vector<string_view> words = SplitIntoWordsNoStop(documents_[document_id].content);
-    const double inv_word_count = 1.0 / words.size();
-    for (string_view word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        documents_[document_id].word_freqs[word] += inv_word_count;
+    vector<int>& word_ids = documents_[document_id].word_ids;
+    word_ids.reserve(documents_[document_id].word_freqs.size());
+    for (const auto& [word, freq] : documents_[document_id].word_freqs) {
+        const int word_id = terms_.Find(word);
+        word_ids.push_back(word_id);
+        word_to_document_freqs_[word_id][document_id] = freq;
+        ++word_document_counts_[word_id];
+    }
+    sort(word_ids.begin(), word_ids.end());
+
+    if (is_position_indexing_enabled_) {
+        //     ,  -   
+        vector<vector<uint32_t>> word_positions(word_ids.size());
+        uint32_t position = 0;
+        for (string_view word : WordRange(document.text)) {
+            if (!IsStopWord(word)) {
+                const int word_id = terms_.Find(word);
+                const size_t word_index = lower_bound(word_ids.begin(), word_ids.end(), word_id) - word_ids.begin();
+                word_positions[word_index].push_back(position);
+            }
+            ++position;
+        }
+
+        DocumentData& document_data = documents_[document_id];
+        document_data.position_offsets.reserve(word_ids.size() + 1);
+        for (const vector<uint32_t>& positions : word_positions) {
+            document_data.position_offsets.push_back(static_cast<uint32_t>(document_data.positions.size()));
+            uint32_t previous_position = 0;
+            for (uint32_t position : positions) {
+                WriteVarint(document_data.positions, position - previous_position);
+                previous_position = position;
+            }
+        }
+        document_data.position_offsets.push_back(static_cast<uint32_t>(document_data.positions.size()));
+        document_data.positions.shrink_to_fit();
+        positions_bytes_ += GetHeapSize(document_data.position_offsets) + GetHeapSize(document_data.positions);
+    }
+    else {
+        ++unpositioned_document_count_;
+    }
+
+    documents_[document_id].fingerprint = ComputeWordSetFingerprint(word_ids);
+    const int duplicate_id = duplicates_.Add(document_id, documents_[document_id].fingerprint);
+
+    posting_count_ += documents_[document_id].word_freqs.size();
+    mutable_posting_count_ += documents_[document_id].word_freqs.size();
+    forward_index_bytes_ += GetHeapSize(word_ids);
+
+    if (++mutable_document_count_ >= MUTABLE_SEGMENT_MAX_DOCUMENT_COUNT) {
+        FlushSegment();
+    }
+
+    //    id     
+    if (duplicate_policy_ == DuplicatePolicy::REJECT && duplicate_id >= 0) {
+        RemoveDocument(duplicate_id);
     }
 }
 
@@ -66,6 +178,66 @@ vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
     return FindTopDocuments(std::execution::seq, raw_query);
 }
 
+SearchResult SearchServer::FindTopDocuments(string_view raw_query, const QueryDeadline& deadline) const {
+    return FindTopDocuments(std::execution::seq, raw_query, deadline);
+}
+
+size_t SearchServer::GetDeadlineMissCount() const {
+    return deadline_miss_count_;
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, QueryTrace& trace) const {
+    return FindTopDocuments(std::execution::seq, raw_query, trace);
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id, QueryTrace& trace) const {
+    if (!document_ids_.count(document_id)) {
+        throw out_of_range("Invalid document ID"s);
+    }
+
+    trace = QueryTrace();
+    trace.raw_query = raw_query;
+    TraceStage total_stage(&trace, &QueryTrace::total_time);
+
+    TraceStage parse_stage(&trace, &QueryTrace::parse_time);
+    const Query parsed_query = ParseQuery(raw_query);
+    const ResolvedQuery query = ResolveQuery(parsed_query);
+    parse_stage.Stop();
+
+    TraceQueryPlan(MakeQueryPlan(parsed_query), trace);
+    TraceUnknownWords(parsed_query, trace);
+    for (string_view word : parsed_query.stop_words) {
+        trace.stop_words.emplace_back(word);
+    }
+
+    const DocumentData& document_data = documents_.at(document_id);
+    TraceStage filter_stage(&trace, &QueryTrace::filter_time);
+    vector<string_view> matched_words = MatchResolvedQuery(query, document_data);
+    filter_stage.Stop();
+
+    // ,        -
+    const bool is_scored = any_of(query.plus_word_ids.begin(), query.plus_word_ids.end(),
+        [&document_data](int word_id) {
+            return ContainsWord(document_data, word_id);
+        });
+    trace.scored_document_count = is_scored ? 1 : 0;
+    if (is_scored && matched_words.empty()) {
+        const bool has_minus_words = any_of(query.minus_word_ids.begin(), query.minus_word_ids.end(),
+            [&document_data](int word_id) {
+                return ContainsWord(document_data, word_id);
+            });
+        ++(has_minus_words ? trace.minus_excluded_document_count : trace.constraint_excluded_document_count);
+    }
+    trace.result_document_count = matched_words.empty() ? 0 : 1;
+    total_stage.Stop();
+
+    if (slow_query_log_) {
+        slow_query_log_->Add(trace);
+    }
+
+    return { matched_words, document_data.status };
+}
+
 
 int SearchServer::GetDocumentCount() const {
     return static_cast<int>(documents_.size());
@@ -76,68 +248,235 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_vi
         throw out_of_range("Invalid document ID"s);
     }
 
-    const Query query = ParseQuery(raw_query);
+    const ResolvedQuery query = ResolveQuery(ParseQuery(raw_query));
+    const DocumentData& document_data = documents_.at(document_id);
+
+    return { MatchResolvedQuery(query, document_data), document_data.status };
+}
+
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(string_view raw_query, const vector<int>& document_ids) const {
+    return MatchDocuments(execution::seq, raw_query, document_ids);
+}
 
-    bool are_minus_words_existed = false;
+std::tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(execution::sequenced_policy seq, string_view raw_query, int document_id) const {
+    return MatchDocument(raw_query, document_id);
+}
+
+std::tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(execution::parallel_policy par, string_view raw_query, int document_id) const {
+    if (!document_ids_.count(document_id)) {
+        throw out_of_range("Invalid document ID"s);
+    }
+
+    const ResolvedQuery query = ResolveQuery(ParseQuery(raw_query));
+    const DocumentData& document_data = documents_.at(document_id);
+
+    return { MatchResolvedQuery(par, query, document_data), document_data.status };
+}
+
+std::tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(AutomaticPolicy, string_view raw_query, int document_id) const {
+    if (!document_ids_.count(document_id)) {
+        throw out_of_range("Invalid document ID"s);
+    }
+
+    //   ,     
+    const Query parsed_query = ParseQuery(raw_query);
+    const ResolvedQuery query = ResolveQuery(parsed_query);
+    const DocumentData& document_data = documents_.at(document_id);
+
+    if (parsed_query.plus_words.size() + parsed_query.minus_words.size() >= PARALLEL_MIN_WORD_COUNT) {
+        return { MatchResolvedQuery(execution::par, query, document_data), document_data.status };
+    }
+
+    return { MatchResolvedQuery(query, document_data), document_data.status };
+}
+
+SearchServer::ResolvedQuery SearchServer::ResolveQuery(const Query& query) const {
+    ResolvedQuery resolved_query;
+
+    //,    ,      
+    for (string_view word : query.plus_words) {
+        const int word_id = FindWordId(word);
+        if (word_id >= 0) {
+            resolved_query.plus_words.push_back(word);
+            resolved_query.plus_word_ids.push_back(word_id);
+        }
+    }
 
     for (string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+        const int word_id = FindWordId(word);
+        if (word_id >= 0) {
+            resolved_query.minus_word_ids.push_back(word_id);
+        }
+    }
+
+    resolved_query.constraints = ResolveConstraints(query);
+
+    return resolved_query;
+}
+
+vector<PositionConstraint> SearchServer::ResolveConstraints(const Query& query) const {
+    if (!query.phrases.empty() && unpositioned_document_count_ > 0) {
+        throw invalid_argument("Phrase and NEAR queries require word positions of every document"s);
+    }
+
+    vector<PositionConstraint> constraints;
+    constraints.reserve(query.phrases.size());
+
+    for (const QueryPhrase& phrase : query.phrases) {
+        PositionConstraint constraint{ {}, {}, phrase.max_distance, phrase.is_phrase, phrase.is_minus };
+        //    ,     
+        for (uint32_t offset : phrase.offsets) {
+            constraint.offsets.push_back(offset - phrase.offsets[0]);
+        }
+        for (string_view word : phrase.words) {
+            constraint.word_ids.push_back(FindWordId(word));
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            are_minus_words_existed = true;
-            break;
+
+        //      : -   ,
+        // -     
+        const bool has_unknown_word = count(constraint.word_ids.begin(), constraint.word_ids.end(), -1) > 0;
+        if (!(constraint.is_minus && has_unknown_word)) {
+            constraints.push_back(move(constraint));
         }
     }
 
-    vector<string_view> matched_words;
-    if (!are_minus_words_existed) {
-        for (string_view word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-            }
-            if (word_to_document_freqs_.at(word).count(document_id)) {
-                matched_words.push_back(word);
+    return constraints;
+}
+
+int SearchServer::GetWordId(string_view word) {
+    const int word_id = terms_.Add(word);
+    if (static_cast<size_t>(word_id) == word_document_counts_.size()) {
+        word_document_counts_.push_back(0);
+    }
+    return word_id;
+}
+
+int SearchServer::FindWordId(string_view word) const {
+    return terms_.Find(word);
+}
+
+bool SearchServer::ContainsWord(const DocumentData& document_data, int word_id) {
+    return binary_search(document_data.word_ids.begin(), document_data.word_ids.end(), word_id);
+}
+
+vector<uint32_t> SearchServer::GetWordPositions(const DocumentData& document_data, int word_id) {
+    const auto it = lower_bound(document_data.word_ids.begin(), document_data.word_ids.end(), word_id);
+    if (document_data.position_offsets.empty() || it == document_data.word_ids.end() || *it != word_id) {
+        return {};
+    }
+
+    const size_t word_index = it - document_data.word_ids.begin();
+    vector<uint32_t> positions;
+    uint32_t position = 0;
+    for (size_t pos = document_data.position_offsets[word_index]; pos < document_data.position_offsets[word_index + 1];) {
+        position += ReadVarint(document_data.positions, pos);
+        positions.push_back(position);
+    }
+    return positions;
+}
+
+bool SearchServer::MatchesConstraint(const DocumentData& document_data, const PositionConstraint& constraint) {
+    // ,       
+    if (!all_of(constraint.word_ids.begin(), constraint.word_ids.end(),
+        [&document_data](int word_id) { return ContainsWord(document_data, word_id); })) {
+        return false;
+    }
+
+    vector<uint32_t> first_positions = GetWordPositions(document_data, constraint.word_ids[0]);
+
+    if (constraint.is_phrase) {
+        //  ,   i-      
+        for (size_t i = 1; i < constraint.word_ids.size() && !first_positions.empty(); ++i) {
+            const vector<uint32_t> positions = GetWordPositions(document_data, constraint.word_ids[i]);
+            const uint32_t offset = constraint.offsets[i];
+            first_positions.erase(remove_if(first_positions.begin(), first_positions.end(),
+                [&positions, offset](uint32_t position) {
+                    return !binary_search(positions.begin(), positions.end(), position + offset);
+                }), first_positions.end());
+        }
+        return !first_positions.empty();
+    }
+
+    //NEAR/k:    ,   k    .
+    //         ,    
+    if (constraint.word_ids[0] == constraint.word_ids[1]) {
+        for (size_t i = 1; i < first_positions.size(); ++i) {
+            if (first_positions[i] - first_positions[i - 1] <= constraint.max_distance) {
+                return true;
             }
-        }    
+        }
+        return false;
     }
 
-    return { matched_words, documents_.at(document_id).status };
+    const vector<uint32_t> second_positions = GetWordPositions(document_data, constraint.word_ids[1]);
+    for (size_t i = 0, j = 0; i < first_positions.size() && j < second_positions.size();) {
+        const uint32_t distance = first_positions[i] < second_positions[j]
+            ? second_positions[j] - first_positions[i]
+            : first_positions[i] - second_positions[j];
+        if (distance <= constraint.max_distance) {
+            return true;
+        }
+        if (first_positions[i] < second_positions[j]) {
+            ++i;
+        }
+        else {
+            ++j;
+        }
+    }
+    return false;
 }
 
-std::tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(execution::sequenced_policy seq, string_view raw_query, int document_id) const {
-    return MatchDocument(raw_query, document_id);
+bool SearchServer::MatchesConstraints(const DocumentData& document_data, const vector<PositionConstraint>& constraints) {
+    return all_of(constraints.begin(), constraints.end(),
+        [&document_data](const PositionConstraint& constraint) {
+            return MatchesConstraint(document_data, constraint) != constraint.is_minus;
+        });
 }
 
-std::tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(execution::parallel_policy par, string_view raw_query, int document_id) const {
-    if (!document_ids_.count(document_id)) {
-        throw out_of_range("Invalid document ID"s);
+vector<string_view> SearchServer::MatchResolvedQuery(const ResolvedQuery& query, const DocumentData& document_data) {
+    for (int word_id : query.minus_word_ids) {
+        if (ContainsWord(document_data, word_id)) {
+            return {};
+        }
     }
 
-    const Query query = ParseQuery(raw_query, false);
-    vector<string_view> matched_words;
+    if (!MatchesConstraints(document_data, query.constraints)) {
+        return {};
+    }
 
-    auto func = [this, document_id](string_view word) { 
-        if (word_to_document_freqs_.count(word) == 0) {
-            return false;
+    vector<string_view> matched_words;
+    for (size_t i = 0; i < query.plus_word_ids.size(); ++i) {
+        if (ContainsWord(document_data, query.plus_word_ids[i])) {
+            matched_words.push_back(query.plus_words[i]);
         }
-        return word_to_document_freqs_.at(word).count(document_id) > 0; 
+    }
+
+    return matched_words;
+}
+
+vector<string_view> SearchServer::MatchResolvedQuery(execution::parallel_policy par, const ResolvedQuery& query, const DocumentData& document_data) {
+    vector<string_view> matched_words;
+
+    auto func = [&document_data](int word_id) {
+        return ContainsWord(document_data, word_id);
     };
 
-    bool are_minus_words_existed = any_of(par, query.minus_words.begin(), query.minus_words.end(), func);
+    bool are_minus_words_existed = any_of(par, query.minus_word_ids.begin(), query.minus_word_ids.end(), func)
+        || !MatchesConstraints(document_data, query.constraints);
 
     if (!are_minus_words_existed) {
-        matched_words.resize(query.plus_words.size());
-        auto it = copy_if(par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), func);
-        matched_words.resize(distance(matched_words.begin(), it));
-    
-        sort(par,matched_words.begin(), matched_words.end());
-        auto to_delete = unique(par,matched_words.begin(), matched_words.end());
-        matched_words.erase(to_delete, matched_words.end());
-    
+        vector<int> word_indexes(query.plus_word_ids.size());
+        iota(word_indexes.begin(), word_indexes.end(), 0);
+
+        vector<int> matched_word_indexes(word_indexes.size());
+        auto it = copy_if(par, word_indexes.begin(), word_indexes.end(), matched_word_indexes.begin(),
+            [&](int index) { return func(query.plus_word_ids[index]); });
+
+        matched_words.reserve(distance(matched_word_indexes.begin(), it));
+        for_each(matched_word_indexes.begin(), it, [&](int index) { matched_words.push_back(query.plus_words[index]); });
     }
 
-    return { matched_words, documents_.at(document_id).status };
+    return matched_words;
 }
 
 bool SearchServer::IsStopWord(string_view word) const {
@@ -146,7 +485,7 @@ bool SearchServer::IsStopWord(string_view word) const {
 
 vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
     vector<string_view> words;
-    for (string_view word : SplitIntoWords(text)) {
+    for (string_view word : WordRange(text)) {
         if (!IsStopWord(word)) {
             words.push_back(word);
         }
@@ -181,16 +520,109 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
         text = text.substr(1);
     }
 
-    return { text, is_minus, IsStopWord(text) };
+    if (text.back() == '*') {
+        if (text.size() == 1) {
+            throw invalid_argument("Empty prefix"s);
+        }
+        // -  -: under*  understand
+        return { text.substr(0, text.size() - 1), is_minus, false, true };
+    }
+
+    return { text, is_minus, IsStopWord(text), false };
 }
 
 SearchServer::Query SearchServer::ParseQuery(string_view text, bool remove_duplicates) const {
     Query query;
 
-    for (string_view word : SplitIntoWords(text)) {
+    bool is_phrase_open = false;
+    //  NEAR/k    -
+    string_view near_operand;
+    // NEAR/k,   ,  0
+    size_t near_distance = 0;
+    //    ,  -
+    uint32_t phrase_position = 0;
+
+    for (string_view word : WordRange(text)) {
+        // "..."  -"..."   ,   
+        if (is_phrase_open || word[0] == '"' || (word.size() > 1 && word[0] == '-' && word[1] == '"')) {
+            if (near_distance > 0) {
+                throw invalid_argument("Invalid NEAR operand"s);
+            }
+            if (!is_phrase_open) {
+                const bool is_minus = word[0] == '-';
+                word.remove_prefix(is_minus ? 2 : 1);
+                query.phrases.push_back({ {}, {}, 0, true, is_minus });
+                is_phrase_open = true;
+                phrase_position = 0;
+            }
+            if (!word.empty() && word.back() == '"') {
+                word.remove_suffix(1);
+                is_phrase_open = false;
+            }
+            near_operand = {};
+            if (word.empty()) {
+                continue;
+            }
+
+            const QueryWord query_word = ParseQueryWord(word);
+            if (query_word.is_minus || query_word.is_prefix || word.find('"') != string_view::npos) {
+                throw invalid_argument("Phrase contains minus-word, prefix or quote"s);
+            }
+            if (!query_word.is_stop) {
+                query.phrases.back().words.push_back(query_word.data);
+                query.phrases.back().offsets.push_back(phrase_position);
+            }
+            else {
+                query.stop_words.push_back(query_word.data);
+            }
+            ++phrase_position;
+            continue;
+        }
+
+        if (word.substr(0, NEAR_OPERATOR_PREFIX.size()) == NEAR_OPERATOR_PREFIX) {
+            if (near_operand.empty() || near_distance > 0) {
+                throw invalid_argument("Invalid NEAR operand"s);
+            }
+            const string_view distance_text = word.substr(NEAR_OPERATOR_PREFIX.size());
+            size_t distance = 0;
+            const auto [ptr, ec] = from_chars(distance_text.data(), distance_text.data() + distance_text.size(), distance);
+            if (ec != errc() || ptr != distance_text.data() + distance_text.size() || distance == 0) {
+                throw invalid_argument("Invalid NEAR distance"s);
+            }
+            near_distance = distance;
+            continue;
+        }
+
         const QueryWord query_word = ParseQueryWord(word);
+        const bool is_plain_plus_word = !query_word.is_minus && !query_word.is_prefix && !query_word.is_stop;
+        if (near_distance > 0) {
+            if (!is_plain_plus_word) {
+                throw invalid_argument("Invalid NEAR operand"s);
+            }
+            query.phrases.push_back({ { near_operand, query_word.data }, {}, near_distance, false, false });
+            near_distance = 0;
+        }
+        near_operand = is_plain_plus_word ? query_word.data : string_view();
 
-        if (!query_word.is_stop) {
+        if (query_word.is_prefix) {
+            //   ,       .
+            //    ,      
+            auto& words = query_word.is_minus ? query.minus_words : query.plus_words;
+            size_t expansion_count = 0;
+            terms_.ForEachTermWithPrefix(query_word.data, [&](int word_id, string_view term) {
+                if (word_document_counts_[word_id] > 0) {
+                    words.push_back(term);
+                    ++expansion_count;
+                }
+                return expansion_count < PREFIX_EXPANSION_MAX_TERM_COUNT;
+            });
+            //        :     ,
+            //     ,    
+            if (expansion_count == 0) {
+                words.push_back(string_view(query_word.data.data(), query_word.data.size() + 1));
+            }
+        }
+        else if (!query_word.is_stop) {
             if (query_word.is_minus) {
                 query.minus_words.push_back(query_word.data);
             }
@@ -198,8 +630,32 @@ SearchServer::Query SearchServer::ParseQuery(string_view text, bool remove_dupli
                 query.plus_words.push_back(query_word.data);
             }
         }
+        else {
+            query.stop_words.push_back(query_word.data);
+        }
     }
 
+    if (is_phrase_open) {
+        throw invalid_argument("Unclosed phrase"s);
+    }
+    if (near_distance > 0) {
+        throw invalid_argument("Invalid NEAR operand"s);
+    }
+
+    //      .  -   
+    query.phrases.erase(remove_if(query.phrases.begin(), query.phrases.end(),
+        [&query](const QueryPhrase& phrase) {
+            if (phrase.words.size() == 1) {
+                (phrase.is_minus ? query.minus_words : query.plus_words).push_back(phrase.words[0]);
+            }
+            else if (phrase.is_phrase && !phrase.is_minus) {
+                for (string_view word : phrase.words) {
+                    query.plus_words.push_back(word);
+                }
+            }
+            return phrase.words.size() < 2;
+        }), query.phrases.end());
+
     if (remove_duplicates) {
         sort(query.minus_words.begin(), query.minus_words.end());
         query.minus_words.erase(unique(query.minus_words.begin(), query.minus_words.end()), query.minus_words.end());
@@ -211,8 +667,236 @@ SearchServer::Query SearchServer::ParseQuery(string_view text, bool remove_dupli
     return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+double SearchServer::ComputeWordInverseDocumentFreq(int word_id) const {
+    return log(GetDocumentCount() * 1.0 / word_document_counts_[word_id]);
+}
+
+void SearchServer::SelectTopDocuments(vector<Document>& documents) {
+    sort(documents.begin(), documents.end(),
+        [](const Document& lhs, const Document& rhs) {
+            if (std::abs(lhs.relevance - rhs.relevance) < ELIPSON) {
+                return lhs.rating > rhs.rating;
+            }
+            else {
+                return lhs.relevance > rhs.relevance;
+            }
+        });
+
+    if (documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+}
+
+vector<pair<int, double>> SearchServer::CollectWordContributions(int word_id) const {
+    vector<pair<int, double>> contributions;
+    contributions.reserve(word_document_counts_[word_id]);
+
+    //  ,   FindAllDocuments,      
+    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word_id);
+    ForEachPosting(word_id, QueryDeadline(), [&](int document_id, double term_freq) {
+        if (documents_.at(document_id).status == DocumentStatus::ACTUAL) {
+            contributions.push_back({ document_id, term_freq * inverse_document_freq });
+        }
+    });
+
+    //   ,     id  
+    sort(contributions.begin(), contributions.end(),
+        [](const pair<int, double>& lhs, const pair<int, double>& rhs) {
+            return lhs.first < rhs.first;
+        });
+    return contributions;
+}
+
+vector<int> SearchServer::CollectWordDocuments(int word_id) const {
+    vector<int> document_ids;
+    document_ids.reserve(word_document_counts_[word_id]);
+    ForEachPosting(word_id, QueryDeadline(), [&](int document_id, double) {
+        document_ids.push_back(document_id);
+    });
+    sort(document_ids.begin(), document_ids.end());
+    return document_ids;
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string>& raw_queries) const {
+    vector<QueryPlan> plans(raw_queries.size());
+    transform(execution::par, raw_queries.begin(), raw_queries.end(), plans.begin(),
+        [this](const string& raw_query) {
+            return MakeQueryPlan(ParseQuery(raw_query));
+        });
+
+    //      ,      
+    vector<int> plus_word_ids;
+    vector<int> minus_word_ids;
+    for (const QueryPlan& plan : plans) {
+        for (const QueryPlan::Word& word : plan.plus_words) {
+            plus_word_ids.push_back(word.id);
+        }
+        for (const QueryPlan::Word& word : plan.minus_words) {
+            minus_word_ids.push_back(word.id);
+        }
+    }
+    sort(plus_word_ids.begin(), plus_word_ids.end());
+    plus_word_ids.erase(unique(plus_word_ids.begin(), plus_word_ids.end()), plus_word_ids.end());
+    sort(minus_word_ids.begin(), minus_word_ids.end());
+    minus_word_ids.erase(unique(minus_word_ids.begin(), minus_word_ids.end()), minus_word_ids.end());
+
+    vector<vector<pair<int, double>>> word_contributions(plus_word_ids.size());
+    vector<vector<int>> word_documents(minus_word_ids.size());
+    {
+        shared_lock lock(segments_mutex_);
+        transform(execution::par, plus_word_ids.begin(), plus_word_ids.end(), word_contributions.begin(),
+            [this](int word_id) {
+                return CollectWordContributions(word_id);
+            });
+        transform(execution::par, minus_word_ids.begin(), minus_word_ids.end(), word_documents.begin(),
+            [this](int word_id) {
+                return CollectWordDocuments(word_id);
+            });
+    }
+
+    const auto find_word_index = [](const vector<int>& word_ids, int word_id) {
+        return static_cast<size_t>(lower_bound(word_ids.begin(), word_ids.end(), word_id) - word_ids.begin());
+    };
+
+    vector<vector<Document>> result(plans.size());
+    transform(execution::par, plans.begin(), plans.end(), result.begin(),
+        [&](const QueryPlan& plan) {
+            //     ,   FindAllDocuments
+            vector<pair<int, double>> contributions;
+            for (const QueryPlan::Word& word : plan.plus_words) {
+                const vector<pair<int, double>>& word_contribution = word_contributions[find_word_index(plus_word_ids, word.id)];
+                contributions.insert(contributions.end(), word_contribution.begin(), word_contribution.end());
+            }
+            stable_sort(contributions.begin(), contributions.end(),
+                [](const pair<int, double>& lhs, const pair<int, double>& rhs) {
+                    return lhs.first < rhs.first;
+                });
+
+            const auto has_minus_words = [&](int document_id) {
+                return any_of(plan.minus_words.begin(), plan.minus_words.end(),
+                    [&](const QueryPlan::Word& word) {
+                        const vector<int>& document_ids = word_documents[find_word_index(minus_word_ids, word.id)];
+                        return binary_search(document_ids.begin(), document_ids.end(), document_id);
+                    });
+            };
+
+            vector<Document> documents;
+            for (size_t begin = 0; begin < contributions.size();) {
+                const int document_id = contributions[begin].first;
+                double relevance = 0.0;
+                size_t end = begin;
+                for (; end < contributions.size() && contributions[end].first == document_id; ++end) {
+                    relevance += contributions[end].second;
+                }
+                if (!has_minus_words(document_id)
+                    && (plan.constraints.empty() || MatchesConstraints(documents_.at(document_id), plan.constraints))) {
+                    documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+                }
+                begin = end;
+            }
+
+            SelectTopDocuments(documents);
+            return documents;
+        });
+
+    return result;
+}
+
+QueryPlan SearchServer::MakeQueryPlan(const Query& query) const {
+    QueryPlan plan;
+
+    //       ,    
+    for (string_view word : query.plus_words) {
+        const int word_id = FindWordId(word);
+        if (word_id >= 0 && word_document_counts_[word_id] > 0) {
+            const size_t posting_count = static_cast<size_t>(word_document_counts_[word_id]);
+            plan.plus_words.push_back({ word, word_id, posting_count });
+            plan.plus_posting_count += posting_count;
+        }
+    }
+
+    for (string_view word : query.minus_words) {
+        const int word_id = FindWordId(word);
+        if (word_id >= 0 && word_document_counts_[word_id] > 0) {
+            const size_t posting_count = static_cast<size_t>(word_document_counts_[word_id]);
+            plan.minus_words.push_back({ word, word_id, posting_count });
+            plan.minus_posting_count += posting_count;
+        }
+    }
+
+    plan.constraints = ResolveConstraints(query);
+
+    return plan;
+}
+
+QueryPlan SearchServer::PlanQuery(const Query& query) const {
+    QueryPlan plan = MakeQueryPlan(query);
+
+    //  :        
+    sort(plan.plus_words.begin(), plan.plus_words.end(),
+        [](const QueryPlan::Word& lhs, const QueryPlan::Word& rhs) {
+            return lhs.posting_count < rhs.posting_count;
+        });
+
+    //   ,   -  -
+    plan.are_minus_words_first = !plan.minus_words.empty() && plan.minus_posting_count < plan.plus_posting_count;
+
+    if (plan.plus_words.size() < 2 || plan.plus_posting_count < PARALLEL_QUERY_MIN_POSTING_COUNT) {
+        return plan;
+    }
+
+    const size_t task_count = min({ static_cast<size_t>(max(thread::hardware_concurrency(), 1u)), plan.plus_words.size(),
+        plan.plus_posting_count / PARALLEL_QUERY_POSTINGS_PER_TASK });
+    if (task_count < 2) {
+        return plan;
+    }
+
+    //    ,         
+    plan.is_parallel = true;
+    plan.word_groups.resize(task_count);
+    using TaskLoad = pair<size_t, size_t>;
+    priority_queue<TaskLoad, vector<TaskLoad>, greater<TaskLoad>> task_loads;
+    for (size_t task = 0; task < task_count; ++task) {
+        task_loads.push({ 0, task });
+    }
+    for (size_t word_index = plan.plus_words.size(); word_index-- > 0;) {
+        auto [load, task] = task_loads.top();
+        task_loads.pop();
+        plan.word_groups[task].push_back(word_index);
+        task_loads.push({ load + plan.plus_words[word_index].posting_count, task });
+    }
+
+    return plan;
+}
+
+void SearchServer::TraceUnknownWords(const Query& query, QueryTrace& trace) const {
+    //  ,  MakeQueryPlan    
+    const auto has_postings = [this](string_view word) {
+        const int word_id = FindWordId(word);
+        return word_id >= 0 && word_document_counts_[word_id] > 0;
+    };
+    for (string_view word : query.plus_words) {
+        if (!has_postings(word)) {
+            trace.plus_words.push_back({ string(word), 0 });
+        }
+    }
+    for (string_view word : query.minus_words) {
+        if (!has_postings(word)) {
+            trace.minus_words.push_back({ string(word), 0 });
+        }
+    }
+}
+
+QueryPlan SearchServer::PlanQuery(string_view raw_query) const {
+    return PlanQuery(ParseQuery(raw_query));
+}
+
+void SearchServer::SetQueryPlanLog(ostream* output) {
+    query_plan_log_ = output;
+}
+
+void SearchServer::SetSlowQueryLog(SlowQueryLog* slow_query_log) {
+    slow_query_log_ = slow_query_log;
 }
 
 bool SearchServer::IsValidWord(string_view word) {
@@ -230,11 +914,68 @@ const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id
     return empty_map;
 }
 
+void SearchServer::SetDocumentStorage(DocumentStorage storage) {
+    document_store_.SetStorage(storage);
+}
+
+void SearchServer::SetPositionIndexing(bool is_enabled) {
+    is_position_indexing_enabled_ = is_enabled;
+}
+
+void SearchServer::SetDuplicatePolicy(DuplicatePolicy policy) {
+    duplicate_policy_ = policy;
+}
+
+vector<int> SearchServer::GetDuplicateIds() const {
+    return duplicates_.GetDuplicateIds();
+}
+
+int SearchServer::FindDuplicateOriginal(const PreparedDocument& document) const {
+    vector<int> word_ids;
+    word_ids.reserve(document.words.size());
+    for (string_view word : document.words) {
+        const int word_id = FindWordId(word);
+        //           
+        if (word_id < 0) {
+            return -1;
+        }
+        word_ids.push_back(word_id);
+    }
+    sort(word_ids.begin(), word_ids.end());
+    word_ids.erase(unique(word_ids.begin(), word_ids.end()), word_ids.end());
+
+    return duplicates_.FindOriginal(ComputeWordSetFingerprint(word_ids));
+}
+
+optional<string> SearchServer::GetDocumentContent(int document_id) const {
+    if (documents_.count(document_id) == 0) {
+        throw out_of_range("Invalid document ID"s);
+    }
+
+    return document_store_.Get(document_id);
+}
+
 void SearchServer::RemoveDocument(int document_id) {
-    for (const auto& [word, freq] : GetWordFrequencies(document_id)) {
-        word_to_document_freqs_.at(word).erase(document_id);
+    if (documents_.count(document_id) == 0) {
+        return;
     }
 
+    for (int word_id : documents_.at(document_id).word_ids) {
+        --word_document_counts_[word_id];
+        const auto it = word_to_document_freqs_.find(word_id);
+        if (it != word_to_document_freqs_.end()) {
+            mutable_posting_count_ -= it->second.erase(document_id);
+        }
+    }
+    RemoveFromSegments(document_id);
+
+    //     ,   ,   
+    if (documents_.at(document_id).position_offsets.empty()) {
+        --unpositioned_document_count_;
+    }
+    ForgetDocumentMemory(document_id);
+    duplicates_.Remove(document_id, documents_.at(document_id).fingerprint);
+    document_store_.Remove(document_id);
     documents_.erase(document_id);
     document_ids_.erase(document_id);
 }
@@ -243,13 +984,259 @@ void SearchServer::RemoveDocument(std::execution::sequenced_policy seq, int docu
     RemoveDocument(document_id);
 }
 
+void SearchServer::RemoveDocument(AutomaticPolicy, int document_id) {
+    const auto it = documents_.find(document_id);
+    if (it != documents_.end() && it->second.word_ids.size() >= PARALLEL_MIN_WORD_COUNT) {
+        RemoveDocument(execution::par, document_id);
+    }
+    else {
+        RemoveDocument(document_id);
+    }
+}
+
 void SearchServer::RemoveDocument(std::execution::parallel_policy par, int document_id) {
-    const map<string_view, double>& word_freqs = GetWordFrequencies(document_id);
-    vector<string_view> words(word_freqs.size());
-    
-    transform(par, word_freqs.begin(), word_freqs.end(), words.begin(), [](auto& word_freq) { return word_freq.first; });
-    for_each(par, words.begin(), words.end(), [&](string_view word) { word_to_document_freqs_.at(word).erase(document_id); });
+    if (documents_.count(document_id) == 0) {
+        return;
+    }
 
+    //  ,      
+    const vector<int>& word_ids = documents_.at(document_id).word_ids;
+    mutable_posting_count_ -= transform_reduce(par, word_ids.begin(), word_ids.end(), size_t{ 0 }, plus<>{},
+        [&](int word_id) {
+            --word_document_counts_[word_id];
+            const auto it = word_to_document_freqs_.find(word_id);
+            return it != word_to_document_freqs_.end() ? it->second.erase(document_id) : size_t{ 0 };
+        });
+    RemoveFromSegments(document_id);
+
+    //     ,   ,   
+    if (documents_.at(document_id).position_offsets.empty()) {
+        --unpositioned_document_count_;
+    }
+    ForgetDocumentMemory(document_id);
+    duplicates_.Remove(document_id, documents_.at(document_id).fingerprint);
+    document_store_.Remove(document_id);
     documents_.erase(document_id);
     document_ids_.erase(find(par, document_ids_.begin(), document_ids_.end(), document_id));
+}
+
+MemoryUsage SearchServer::GetMemoryUsage() const {
+    MemoryUsage memory_usage = GetCachedMemoryUsage();
+
+    //    
+    shared_lock lock(segments_mutex_);
+    memory_usage.segments = GetHeapSize(segments_);
+    for (const auto& segment : segments_) {
+        memory_usage.segments += segment->GetMemoryUsage();
+    }
+
+    return memory_usage;
+}
+
+MemoryUsage SearchServer::GetCachedMemoryUsage() const {
+    MemoryUsage memory_usage;
+
+    memory_usage.documents = documents_.size() * GetTreeNodeSize<pair<const int, DocumentData>>();
+    memory_usage.content = document_store_.GetMemoryUsage();
+    memory_usage.word_freqs = posting_count_ * GetTreeNodeSize<pair<const string_view, double>>();
+    memory_usage.forward_index = forward_index_bytes_;
+    memory_usage.word_to_document_freqs = word_to_document_freqs_.size() * GetTreeNodeSize<pair<const int, map<int, double>>>()
+        + mutable_posting_count_ * GetTreeNodeSize<pair<const int, double>>();
+    memory_usage.document_ids = document_ids_.size() * GetTreeNodeSize<int>();
+    memory_usage.dictionary = terms_.GetMemoryUsage() + GetHeapSize(word_document_counts_);
+    memory_usage.segments = segments_bytes_;
+    memory_usage.duplicates = duplicates_.GetMemoryUsage();
+    memory_usage.positions = positions_bytes_;
+
+    memory_usage.stop_words = stop_words_bytes_;
+
+    return memory_usage;
+}
+
+void SearchServer::SetMemoryBudget(size_t memory_budget) {
+    memory_budget_ = memory_budget;
+}
+
+size_t SearchServer::GetMemoryBudget() const {
+    return memory_budget_;
+}
+
+size_t SearchServer::EstimateDocumentMemory(const PreparedDocument& document) const {
+    size_t memory = GetTreeNodeSize<pair<const int, DocumentData>>() + GetTreeNodeSize<int>() + document_store_.EstimateMemory(document.text)
+        + GetHashNodeSize<pair<const WordSetFingerprint, int>>();
+
+    vector<string_view> words = document.words;
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+
+    memory += words.size() * (GetTreeNodeSize<pair<const string_view, double>>() + GetTreeNodeSize<pair<const int, double>>() + sizeof(int));
+    for (string_view word : words) {
+        const int word_id = FindWordId(word);
+        if (word_id < 0) {
+            memory += TermPool::EstimateTermMemory(word.size()) + sizeof(int);
+        }
+        if (word_id < 0 || word_to_document_freqs_.count(word_id) == 0) {
+            memory += GetTreeNodeSize<pair<const int, map<int, double>>>();
+        }
+    }
+
+    //     varint,     
+    if (is_position_indexing_enabled_) {
+        memory += document.words.size() + (words.size() + 1) * sizeof(uint32_t);
+    }
+
+    return memory;
+}
+
+void SearchServer::ForgetDocumentMemory(int document_id) {
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end()) {
+        return;
+    }
+
+    posting_count_ -= it->second.word_freqs.size();
+    forward_index_bytes_ -= GetHeapSize(it->second.word_ids);
+    positions_bytes_ -= GetHeapSize(it->second.position_offsets) + GetHeapSize(it->second.positions);
+}
+
+void SearchServer::FlushSegment() {
+    if (mutable_document_count_ == 0) {
+        return;
+    }
+
+    auto segment = make_shared<IndexSegment>(word_to_document_freqs_);
+    {
+        unique_lock lock(segments_mutex_);
+        if (segment->GetDocumentCount() > 0) {
+            const size_t capacity_bytes = GetHeapSize(segments_);
+            segments_bytes_ += segment->GetMemoryUsage();
+            segments_.push_back(move(segment));
+            segments_bytes_ = segments_bytes_ + GetHeapSize(segments_) - capacity_bytes;
+        }
+    }
+
+    word_to_document_freqs_.clear();
+    mutable_document_count_ = 0;
+    mutable_posting_count_ = 0;
+
+    RequestMerge();
+}
+
+void SearchServer::RemoveFromSegments(int document_id) {
+    bool is_merge_needed = false;
+    {
+        unique_lock lock(segments_mutex_);
+        for (const auto& segment : segments_) {
+            if (segment->MarkDeleted(document_id)) {
+                is_merge_needed = segment->GetLiveDocumentCount() * 2 < segment->GetDocumentCount();
+                break;
+            }
+        }
+    }
+
+    if (is_merge_needed) {
+        RequestMerge();
+    }
+}
+
+void SearchServer::RequestMerge() {
+    //        ,     ,
+    //     
+    if (!merge_thread_.joinable()) {
+        merge_thread_ = thread(&SearchServer::RunMergeThread, this);
+    }
+
+    {
+        lock_guard guard(merge_mutex_);
+        is_merge_requested_ = true;
+    }
+    merge_condition_.notify_one();
+}
+
+void SearchServer::RunMergeThread() {
+    unique_lock lock(merge_mutex_);
+    while (true) {
+        merge_condition_.wait(lock, [this] { return is_merge_requested_ || is_stopping_; });
+        if (is_stopping_) {
+            return;
+        }
+
+        is_merge_requested_ = false;
+        lock.unlock();
+        while (MergeSegments()) {
+        }
+        lock.lock();
+    }
+}
+
+//           SEGMENT_MERGE_FACTOR .
+// SEGMENT_MERGE_FACTOR   ; ,    
+//,  
+bool SearchServer::MergeSegments() {
+    vector<shared_ptr<IndexSegment>> sources;
+    vector<vector<bool>> deleted;
+    {
+        shared_lock lock(segments_mutex_);
+        map<int, vector<shared_ptr<IndexSegment>>> tier_to_segments;
+
+        for (const auto& segment : segments_) {
+            const int64_t live_document_count = segment->GetLiveDocumentCount();
+            if (live_document_count * 2 < segment->GetDocumentCount()) {
+                sources = { segment };
+                break;
+            }
+
+            int tier = 0;
+            for (int64_t size = MUTABLE_SEGMENT_MAX_DOCUMENT_COUNT * SEGMENT_MERGE_FACTOR; live_document_count >= size; size *= SEGMENT_MERGE_FACTOR) {
+                ++tier;
+            }
+
+            vector<shared_ptr<IndexSegment>>& tier_segments = tier_to_segments[tier];
+            tier_segments.push_back(segment);
+            if (tier_segments.size() == SEGMENT_MERGE_FACTOR) {
+                sources = move(tier_segments);
+                break;
+            }
+        }
+
+        for (const auto& segment : sources) {
+            deleted.push_back(segment->GetDeleted());
+        }
+    }
+
+    if (sources.empty()) {
+        return false;
+    }
+
+    //   :  ,     
+    auto merged = make_shared<IndexSegment>(sources, deleted);
+
+    unique_lock lock(segments_mutex_);
+
+    // ,    
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const vector<bool>& current_deleted = sources[i]->GetDeleted();
+        for (size_t document_index = 0; document_index < current_deleted.size(); ++document_index) {
+            if (current_deleted[document_index] && !deleted[i][document_index]) {
+                merged->MarkDeleted(sources[i]->GetDocumentId(static_cast<int>(document_index)));
+            }
+        }
+    }
+
+    *find(segments_.begin(), segments_.end(), sources.front()) = merged;
+    for (size_t i = 1; i < sources.size(); ++i) {
+        segments_.erase(find(segments_.begin(), segments_.end(), sources[i]));
+    }
+    if (merged->GetDocumentCount() == 0) {
+        segments_.erase(find(segments_.begin(), segments_.end(), merged));
+    }
+
+    //erase    segments_,      
+    size_t source_bytes = 0;
+    for (const auto& segment : sources) {
+        source_bytes += segment->GetMemoryUsage();
+    }
+    segments_bytes_ = segments_bytes_ + (merged->GetDocumentCount() > 0 ? merged->GetMemoryUsage() : 0) - source_bytes;
+
+    return true;
 }
\ No newline at end of file
@@ -3,13 +3,35 @@
 #include "document.h"
 #include "log_duration.h"
 #include "concurrent_map.h"
+#include "memory_usage.h"
+#include "index_segment.h"
+#include "small_vector.h"
+#include "query_plan.h"
+#include "query_deadline.h"
+#include "query_trace.h"
+#include "term_pool.h"
+#include "document_store.h"
+#include "duplicate_index.h"
 
 #include <execution>
 #include <deque>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <shared_mutex>
+#include <thread>
+#include <optional>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double ELIPSON = 1e-6;
+//       
+const int MUTABLE_SEGMENT_MAX_DOCUMENT_COUNT = 1000;
+//      
+const int SEGMENT_MERGE_FACTOR = 4;
+// -  -      
+const size_t QUERY_INLINE_WORD_COUNT = 16;
+//       word*
+const size_t PREFIX_EXPANSION_MAX_TERM_COUNT = 64;
 
 class SearchServer {
 public:
@@ -18,12 +40,28 @@ public:
     explicit SearchServer(const std::string& stop_words_text);
     explicit SearchServer(std::string_view stop_words_text);
 
+    //       ,   
+    //  .      
+    SearchServer(const SearchServer&) = delete;
+    SearchServer& operator=(const SearchServer&) = delete;
+    ~SearchServer();
+
     std::set<int>::iterator begin();
 
     std::set<int>::iterator end();
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    //,       -.    text
+    struct PreparedDocument {
+        std::string_view text;
+        std::vector<std::string_view> words;
+    };
+
+    //  ,        
+    PreparedDocument PrepareDocument(std::string_view document) const;
+    void AddDocument(int document_id, const PreparedDocument& document, DocumentStatus status, const std::vector<int>& ratings);
+
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
     template <typename ExecutionPolicy, typename DocumentPredicate>
@@ -37,35 +75,179 @@ public:
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query) const;
 
+    //      ,    
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    SearchResult FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate, const QueryDeadline& deadline) const;
+    template <typename ExecutionPolicy>
+    SearchResult FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const QueryDeadline& deadline) const;
+    SearchResult FindTopDocuments(std::string_view raw_query, const QueryDeadline& deadline) const;
+
+    //   ProcessQueries:          .
+    //      FindTopDocuments(raw_query)
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries) const;
+
+    //     -   
+    size_t GetDeadlineMissCount() const;
+
+    //    trace:  ,   ,
+    //    ,  ,   
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate, QueryTrace& trace) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, QueryTrace& trace) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, QueryTrace& trace) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id, QueryTrace& trace) const;
+
+    //  ,   FindTopDocuments,    ,
+    //    ,   . FindTopDocumentsBatch  
+    void SetSlowQueryLog(SlowQueryLog* slow_query_log);
+
     int GetDocumentCount() const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy seq, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy par, std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(AutomaticPolicy, std::string_view raw_query, int document_id) const;
+
+    //          document_ids
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const;
+    template <typename ExecutionPolicy>
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const std::vector<int>& document_ids) const;
 
     const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
 
+    //     ,   
+    void SetDocumentStorage(DocumentStorage storage);
+    //nullopt,     
+    std::optional<std::string> GetDocumentContent(int document_id) const;
+
+    //   ,       
+    void SetDuplicatePolicy(DuplicatePolicy policy);
+    //,           id,  
+    std::vector<int> GetDuplicateIds() const;
+
+    //    ,   . -  .
+    //      ,    "..."  NEAR/k
+    // invalid_argument:      ,   -
+    void SetPositionIndexing(bool is_enabled);
+
     void RemoveDocument(int document_id);
     void RemoveDocument(std::execution::sequenced_policy seq, int document_id);
     void RemoveDocument(std::execution::parallel_policy par, int document_id);
+    void RemoveDocument(AutomaticPolicy, int document_id);
+
+    // "..."    NEAR/k   
+    struct QueryPhrase {
+        std::vector<std::string_view> words;
+        //       -
+        std::vector<uint32_t> offsets;
+        size_t max_distance;
+        bool is_phrase;
+        bool is_minus;
+    };
+
+    struct Query {
+        SmallVector<std::string_view, QUERY_INLINE_WORD_COUNT> plus_words;
+        SmallVector<std::string_view, QUERY_INLINE_WORD_COUNT> minus_words;
+        //   
+        SmallVector<std::string_view, QUERY_INLINE_WORD_COUNT> stop_words;
+        std::vector<QueryPhrase> phrases;
+    };
+
+    // ,    .    text,     
+    Query ParseQuery(std::string_view text, bool remove_duplicates = true) const;
+
+    //,   automatic_policy   
+    QueryPlan PlanQuery(std::string_view raw_query) const;
+    //  ,        automatic_policy
+    void SetQueryPlanLog(std::ostream* output);
+
+    //  ,    
+    void FlushSegment();
+
+    MemoryUsage GetMemoryUsage() const;
+
+    //   AddDocument  ; 0   
+    void SetMemoryBudget(size_t memory_budget);
+    size_t GetMemoryBudget() const;
 
 private:
     struct DocumentData {
-        std::string content;
         int rating;
         DocumentStatus status;
+        //    TermPool,     
         std::map<std::string_view, double> word_freqs;
+        // :  id   
+        std::vector<int> word_ids;
+        WordSetFingerprint fingerprint;
+        //   - :  i-   word_ids    varint
+        // position_offsets[i]  position_offsets[i + 1]. ,    
+        std::vector<uint32_t> position_offsets;
+        std::string positions;
     };
 
     //,   
     const std::set<std::string, std::less<>> stop_words_;
     std::map<int, DocumentData> documents_;
+    DocumentStore document_store_;
+    DuplicateIndex duplicates_;
+    DuplicatePolicy duplicate_policy_ = DuplicatePolicy::ALLOW;
+    bool is_position_indexing_enabled_ = false;
+    //,   
+    size_t unpositioned_document_count_ = 0;
 
-    //,   string view
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    
     std::set<int> document_ids_;
 
+    //  :  -> id,        IDF
+    TermPool terms_;
+    std::vector<int> word_document_counts_;
+
+    // : id  -> ;    
+    std::map<int, std::map<int, double>> word_to_document_freqs_;
+    int mutable_document_count_ = 0;
+
+    // .    ,
+    //,       
+    std::vector<std::shared_ptr<IndexSegment>> segments_;
+    mutable std::shared_mutex segments_mutex_;
+
+    std::mutex merge_mutex_;
+    std::condition_variable merge_condition_;
+    bool is_merge_requested_ = false;
+    bool is_stopping_ = false;
+    // ,      
+    std::thread merge_thread_;
+
+    //  GetMemoryUsage,      
+    size_t posting_count_ = 0;
+    size_t mutable_posting_count_ = 0;
+    size_t forward_index_bytes_ = 0;
+    size_t positions_bytes_ = 0;
+    size_t stop_words_bytes_ = 0;
+    //  ,  
+    std::atomic<size_t> segments_bytes_ = 0;
+    size_t memory_budget_ = 0;
+
+    // ,  GetMemoryUsage(),      :     
+    MemoryUsage GetCachedMemoryUsage() const;
+    size_t EstimateDocumentMemory(const PreparedDocument& document) const;
+    void ForgetDocumentMemory(int document_id);
+
+    void RemoveFromSegments(int document_id);
+
+    //      -1;   
+    int FindDuplicateOriginal(const PreparedDocument& document) const;
+
+    void RequestMerge();
+    void RunMergeThread();
+    bool MergeSegments();
+
+    mutable std::atomic<size_t> deadline_miss_count_ = 0;
+
+    // false,     
+    template <typename Function>
+    bool ForEachPosting(int word_id, const QueryDeadline& deadline, Function function) const;
+
     bool IsStopWord(std::string_view word) const;
 
     std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
@@ -76,25 +258,68 @@ private:
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        //  word*, data    
+        bool is_prefix;
     };
 
     QueryWord ParseQueryWord(std::string_view text) const;
 
-    struct Query {
+    //,      id 
+    struct ResolvedQuery {
         std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::vector<int> plus_word_ids;
+        std::vector<int> minus_word_ids;
+        std::vector<PositionConstraint> constraints;
     };
 
-    Query ParseQuery(std::string_view text, bool remove_duplicates = true) const;
+    ResolvedQuery ResolveQuery(const Query& query) const;
+    std::vector<PositionConstraint> ResolveConstraints(const Query& query) const;
+
+    int GetWordId(std::string_view word);
+    int FindWordId(std::string_view word) const;
+
+    static bool ContainsWord(const DocumentData& document_data, int word_id);
+    static std::vector<uint32_t> GetWordPositions(const DocumentData& document_data, int word_id);
+    static bool MatchesConstraint(const DocumentData& document_data, const PositionConstraint& constraint);
+    // -     -  
+    static bool MatchesConstraints(const DocumentData& document_data, const std::vector<PositionConstraint>& constraints);
+
+    static std::vector<std::string_view> MatchResolvedQuery(const ResolvedQuery& query, const DocumentData& document_data);
+    static std::vector<std::string_view> MatchResolvedQuery(std::execution::parallel_policy par, const ResolvedQuery& query, const DocumentData& document_data);
 
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    double ComputeWordInverseDocumentFreq(int word_id) const;
+
+    //       MAX_RESULT_DOCUMENT_COUNT 
+    static void SelectTopDocuments(std::vector<Document>& documents);
+
+    //      ,   id.
+    //  segments_mutex_
+    std::vector<std::pair<int, double>> CollectWordContributions(int word_id) const;
+    //id   ,  .   segments_mutex_
+    std::vector<int> CollectWordDocuments(int word_id) const;
+
+    std::ostream* query_plan_log_ = nullptr;
+    mutable std::mutex query_plan_log_mutex_;
+    SlowQueryLog* slow_query_log_ = nullptr;
+
+    //  :    , -   
+    QueryPlan MakeQueryPlan(const Query& query) const;
+    QueryPlan PlanQuery(const Query& query) const;
+    //    ,    ,   
+    void TraceUnknownWords(const Query& query, QueryTrace& trace) const;
+
+    //trace == nullptr,    
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    SearchResult FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate, const QueryDeadline& deadline, QueryTrace* trace) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+    SearchResult FindAllDocuments(const QueryPlan& plan, DocumentPredicate document_predicate, const QueryDeadline& deadline, QueryTrace* trace) const;
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy seq, const Query& query, DocumentPredicate document_predicate) const;
+    SearchResult FindAllDocuments(std::execution::sequenced_policy seq, const Query& query, DocumentPredicate document_predicate, const QueryDeadline& deadline, QueryTrace* trace) const;
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::parallel_policy par, const Query& query, DocumentPredicate document_predicate) const;
+    SearchResult FindAllDocuments(std::execution::parallel_policy par, const Query& query, DocumentPredicate document_predicate, const QueryDeadline& deadline, QueryTrace* trace) const;
+    template <typename DocumentPredicate>
+    SearchResult FindAllDocuments(AutomaticPolicy, const Query& query, DocumentPredicate document_predicate, const QueryDeadline& deadline, QueryTrace* trace) const;
 
     static bool IsValidWord(std::string_view word);
 
@@ -108,6 +333,10 @@ template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer& stop_words)
     :stop_words_(MakeUniqueNonEmptyStrings(stop_words)) {
     AreValidWords(stop_words_);
+    stop_words_bytes_ = stop_words_.size() * GetTreeNodeSize<std::string>();
+    for (const std::string& stop_word : stop_words_) {
+        stop_words_bytes_ += GetHeapSize(stop_word);
+    }
 }
 
 template <typename DocumentPredicate>
@@ -117,24 +346,7 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    const Query query = ParseQuery(raw_query);
-    std::vector<Document> result = FindAllDocuments(policy, query, document_predicate);
-
-    sort(result.begin(), result.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < ELIPSON) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-
-    if (result.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        result.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-
-    return result;
+    return FindTopDocuments(policy, raw_query, document_predicate, QueryDeadline()).documents;
 }
 
 template <typename ExecutionPolicy>
@@ -151,81 +363,373 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& poli
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
+template <typename ExecutionPolicy, typename DocumentPredicate>
+SearchResult SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate, const QueryDeadline& deadline) const {
+    if (!slow_query_log_) {
+        return FindTopDocuments(policy, raw_query, document_predicate, deadline, nullptr);
+    }
 
-    for (std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
+    QueryTrace trace;
+    SearchResult result = FindTopDocuments(policy, raw_query, document_predicate, deadline, &trace);
+    slow_query_log_->Add(std::move(trace));
+    return result;
+}
 
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
-            }
+template <typename ExecutionPolicy, typename DocumentPredicate>
+SearchResult SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate, const QueryDeadline& deadline, QueryTrace* trace) const {
+    TraceStage total_stage(trace, &QueryTrace::total_time);
+    TraceStage parse_stage(trace, &QueryTrace::parse_time);
+    const Query query = ParseQuery(raw_query);
+    parse_stage.Stop();
+
+    if (trace) {
+        trace->raw_query = raw_query;
+        for (std::string_view word : query.stop_words) {
+            trace->stop_words.emplace_back(word);
         }
     }
 
-    for (std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
+    SearchResult result = FindAllDocuments(policy, query, document_predicate, deadline, trace);
+    if (trace) {
+        TraceUnknownWords(query, *trace);
+    }
+    TraceStage sort_stage(trace, &QueryTrace::sort_time);
+    SelectTopDocuments(result.documents);
+    sort_stage.Stop();
 
-        for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
-        }
+    if (result.is_partial) {
+        ++deadline_miss_count_;
+    }
+    if (trace) {
+        trace->is_partial = result.is_partial;
+        trace->result_document_count = result.documents.size();
     }
+    total_stage.Stop();
+
+    return result;
+}
 
-    std::vector<Document> matched_documents;
-    for (const auto& [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate, QueryTrace& trace) const {
+    trace = QueryTrace();
+    SearchResult result = FindTopDocuments(policy, raw_query, document_predicate, QueryDeadline(), &trace);
+    if (slow_query_log_) {
+        slow_query_log_->Add(trace);
     }
+    return std::move(result.documents);
+}
 
-    return matched_documents;
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, QueryTrace& trace) const {
+    return FindTopDocuments(policy, raw_query,
+        [](int, DocumentStatus document_status, int) {
+            return document_status == DocumentStatus::ACTUAL;
+        },
+        trace
+    );
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy seq, const Query& query, DocumentPredicate document_predicate) const {
-    return FindAllDocuments(query, document_predicate);
+template <typename ExecutionPolicy>
+SearchResult SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const QueryDeadline& deadline) const {
+    return FindTopDocuments(policy, raw_query,
+        [](int, DocumentStatus document_status, int) {
+            return document_status == DocumentStatus::ACTUAL;
+        },
+        deadline
+    );
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy par, const Query& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(32);
+SearchResult SearchServer::FindAllDocuments(const QueryPlan& plan, DocumentPredicate document_predicate, const QueryDeadline& deadline, QueryTrace* trace) const {
+    std::shared_lock lock(segments_mutex_);
+    std::atomic_bool is_interrupted = false;
 
-    std::for_each(par, query.plus_words.begin(), query.plus_words.end(),
-        [&](std::string_view word) {
-            if (word_to_document_freqs_.count(word) > 0) {
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                    const auto& document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+    if (trace) {
+        TraceQueryPlan(plan, *trace);
+    }
+    TraceStage traversal_stage(trace, &QueryTrace::traversal_time);
+
+    //     ,    
+    //   : true  - -, false  - 
+    std::optional<ConcurrentMap<int, bool>> excluded_documents;
+    if (trace) {
+        excluded_documents.emplace(32);
+    }
+
+    // -  -,    
+    std::vector<int> excluded_document_ids;
+    if (plan.are_minus_words_first) {
+        for (const QueryPlan::Word& word : plan.minus_words) {
+            if (!ForEachPosting(word.id, deadline, [&](int document_id, double) {
+                    excluded_document_ids.push_back(document_id);
+                })) {
+                //        
+                return { {}, true };
+            }
+        }
+        std::sort(excluded_document_ids.begin(), excluded_document_ids.end());
+    }
+
+    const auto is_document_matched = [&](int document_id) {
+        if (!excluded_document_ids.empty() && std::binary_search(excluded_document_ids.begin(), excluded_document_ids.end(), document_id)) {
+            if (excluded_documents) {
+                (*excluded_documents)[document_id].ref_to_value = true;
+            }
+            return false;
+        }
+        const DocumentData& document_data = documents_.at(document_id);
+        if (!document_predicate(document_id, document_data.status, document_data.rating)) {
+            if (excluded_documents) {
+                (*excluded_documents)[document_id].ref_to_value = false;
+            }
+            return false;
+        }
+        return true;
+    };
+
+    //  -  ,       
+    const auto has_minus_words = [&](int document_id) {
+        const DocumentData& document_data = documents_.at(document_id);
+        return std::any_of(plan.minus_words.begin(), plan.minus_words.end(),
+            [&document_data](const QueryPlan::Word& word) {
+                return ContainsWord(document_data, word.id);
+            });
+    };
+
+    SearchResult result;
+
+    //    ,    
+    const auto is_result_kept = [&](int document_id) {
+        if (result.is_partial && !plan.are_minus_words_first && has_minus_words(document_id)) {
+            if (trace) {
+                ++trace->minus_excluded_document_count;
+            }
+            return false;
+        }
+        if (!plan.constraints.empty() && !MatchesConstraints(documents_.at(document_id), plan.constraints)) {
+            if (trace) {
+                ++trace->constraint_excluded_document_count;
+            }
+            return false;
+        }
+        return true;
+    };
+
+    //   ,     .
+    //,  -    ,      
+    const auto trace_exclusions = [&](size_t scored_document_count, size_t gathered_document_count) {
+        if (!trace) {
+            return;
+        }
+        excluded_documents->ForEach(std::execution::seq,
+            [trace](int, bool is_minus) {
+                ++(is_minus ? trace->minus_excluded_document_count : trace->predicate_excluded_document_count);
+            });
+        trace->minus_excluded_document_count += scored_document_count - gathered_document_count;
+        trace->scored_document_count = scored_document_count;
+    };
+
+    if (!plan.is_parallel) {
+        std::map<int, double> document_to_relevance;
+
+        for (const QueryPlan::Word& word : plan.plus_words) {
+            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word.id);
+            if (!ForEachPosting(word.id, deadline, [&](int document_id, double term_freq) {
+                    if (is_document_matched(document_id)) {
+                        document_to_relevance[document_id] += term_freq * inverse_document_freq;
                     }
+                })) {
+                is_interrupted = true;
+                break;
+            }
+        }
+
+        const size_t scored_document_count = document_to_relevance.size();
+        if (!plan.are_minus_words_first && !is_interrupted) {
+            for (const QueryPlan::Word& word : plan.minus_words) {
+                if (!ForEachPosting(word.id, deadline, [&](int document_id, double) {
+                        document_to_relevance.erase(document_id);
+                    })) {
+                    is_interrupted = true;
+                    break;
+                }
+            }
+        }
+        traversal_stage.Stop();
+
+        TraceStage filter_stage(trace, &QueryTrace::filter_time);
+        result.is_partial = is_interrupted;
+        for (const auto& [document_id, relevance] : document_to_relevance) {
+            if (is_result_kept(document_id)) {
+                result.documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+            }
+        }
+        trace_exclusions(scored_document_count, document_to_relevance.size());
+
+        return result;
+    }
+
+    ConcurrentMap<int, double> document_to_relevance(32);
+
+    std::for_each(std::execution::par, plan.word_groups.begin(), plan.word_groups.end(),
+        [&](const std::vector<size_t>& word_group) {
+            for (size_t word_index : word_group) {
+                const QueryPlan::Word& word = plan.plus_words[word_index];
+                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word.id);
+                if (is_interrupted || !ForEachPosting(word.id, deadline, [&](int document_id, double term_freq) {
+                        if (is_document_matched(document_id)) {
+                            document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+                        }
+                    })) {
+                    is_interrupted = true;
+                    return;
                 }
             }
         }
     );
 
-    std::for_each(par, query.minus_words.begin(), query.minus_words.end(),
-        [&](std::string_view word) {
-            if (word_to_document_freqs_.count(word) > 0) {
-                for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-                    document_to_relevance.erase(document_id);
+    size_t scored_document_count = 0;
+    if (trace) {
+        document_to_relevance.ForEach(std::execution::seq,
+            [&scored_document_count](int, double) {
+                ++scored_document_count;
+            });
+    }
+    if (!plan.are_minus_words_first && !is_interrupted) {
+        std::for_each(std::execution::par, plan.minus_words.begin(), plan.minus_words.end(),
+            [&](const QueryPlan::Word& word) {
+                if (is_interrupted || !ForEachPosting(word.id, deadline, [&](int document_id, double) {
+                        document_to_relevance.erase(document_id);
+                    })) {
+                    is_interrupted = true;
                 }
             }
+        );
+    }
+    traversal_stage.Stop();
+
+    TraceStage filter_stage(trace, &QueryTrace::filter_time);
+    result.is_partial = is_interrupted;
+    size_t gathered_document_count = 0;
+    document_to_relevance.ForEach(std::execution::seq,
+        [&](int document_id, double relevance) {
+            ++gathered_document_count;
+            if (is_result_kept(document_id)) {
+                result.documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+            }
         }
     );
+    trace_exclusions(scored_document_count, gathered_document_count);
+
+    //    ,       
+    std::sort(std::execution::par, result.documents.begin(), result.documents.end(),
+        [](const Document& lhs, const Document& rhs) {
+            return lhs.id < rhs.id;
+        });
+
+    return result;
+}
+
+template <typename DocumentPredicate>
+SearchResult SearchServer::FindAllDocuments(std::execution::sequenced_policy seq, const Query& query, DocumentPredicate document_predicate, const QueryDeadline& deadline, QueryTrace* trace) const {
+    TraceStage plan_stage(trace, &QueryTrace::parse_time);
+    const QueryPlan plan = MakeQueryPlan(query);
+    plan_stage.Stop();
+
+    return FindAllDocuments(plan, document_predicate, deadline, trace);
+}
+
+template <typename DocumentPredicate>
+SearchResult SearchServer::FindAllDocuments(std::execution::parallel_policy, const Query& query, DocumentPredicate document_predicate, const QueryDeadline& deadline, QueryTrace* trace) const {
+    TraceStage plan_stage(trace, &QueryTrace::parse_time);
+    QueryPlan plan = MakeQueryPlan(query);
+    plan.is_parallel = true;
+    for (size_t word_index = 0; word_index < plan.plus_words.size(); ++word_index) {
+        plan.word_groups.push_back({ word_index });
+    }
+    plan_stage.Stop();
 
-    std::vector<Document> matched_documents;
-    for (const auto& [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    return FindAllDocuments(plan, document_predicate, deadline, trace);
+}
+
+template <typename DocumentPredicate>
+SearchResult SearchServer::FindAllDocuments(AutomaticPolicy, const Query& query, DocumentPredicate document_predicate, const QueryDeadline& deadline, QueryTrace* trace) const {
+    TraceStage plan_stage(trace, &QueryTrace::parse_time);
+    const QueryPlan plan = PlanQuery(query);
+    plan_stage.Stop();
+    if (query_plan_log_) {
+        std::lock_guard guard(query_plan_log_mutex_);
+        *query_plan_log_ << plan << std::endl;
+    }
+
+    return FindAllDocuments(plan, document_predicate, deadline, trace);
+}
+
+template <typename ExecutionPolicy>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const std::vector<int>& document_ids) const {
+    using namespace std::string_literals;
+
+    for (int document_id : document_ids) {
+        if (!document_ids_.count(document_id)) {
+            throw std::out_of_range("Invalid document ID"s);
+        }
+    }
+
+    const ResolvedQuery query = ResolveQuery(ParseQuery(raw_query));
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> result(document_ids.size());
+
+    const auto match_document = [this, &query](int document_id) {
+        const DocumentData& document_data = documents_.at(document_id);
+        return std::tuple{ MatchResolvedQuery(query, document_data), document_data.status };
+    };
+
+    if constexpr (std::is_same_v<ExecutionPolicy, AutomaticPolicy>) {
+        if (document_ids.size() >= PARALLEL_MATCH_MIN_DOCUMENT_COUNT) {
+            std::transform(std::execution::par, document_ids.begin(), document_ids.end(), result.begin(), match_document);
+        }
+        else {
+            std::transform(document_ids.begin(), document_ids.end(), result.begin(), match_document);
+        }
+    }
+    else {
+        std::transform(policy, document_ids.begin(), document_ids.end(), result.begin(), match_document);
+    }
+
+    return result;
+}
+
+//     ,   .
+//  segments_mutex_
+template <typename Function>
+bool SearchServer::ForEachPosting(int word_id, const QueryDeadline& deadline, Function function) const {
+    //    ,        
+    size_t posting_count = 0;
+    const auto is_block_expired = [&posting_count, &deadline]() {
+        return posting_count++ % DEADLINE_CHECK_POSTING_COUNT == 0 && deadline.IsExpired();
+    };
+
+    const auto it = word_to_document_freqs_.find(word_id);
+    if (it != word_to_document_freqs_.end()) {
+        for (const auto& [document_id, term_freq] : it->second) {
+            if (is_block_expired()) {
+                return false;
+            }
+            function(document_id, term_freq);
+        }
+    }
+
+    for (const auto& segment : segments_) {
+        for (const IndexSegment::Posting& posting : segment->GetPostings(word_id)) {
+            if (is_block_expired()) {
+                return false;
+            }
+            if (!segment->IsDeleted(posting.document_index)) {
+                function(posting.document_id, posting.term_freq);
+            }
+        }
     }
 
-    return matched_documents;
+    return true;
 }
 
 template <typename StringContainer>
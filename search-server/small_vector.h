@@ -0,0 +1,87 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+//,  N     .
+// ,      N
+template <typename Type, size_t N>
+class SmallVector {
+public:
+    using value_type = Type;
+    using iterator = Type*;
+    using const_iterator = const Type*;
+
+    void push_back(const Type& value) {
+        if (heap_.empty() && size_ < N) {
+            inline_[size_++] = value;
+            return;
+        }
+        if (heap_.empty()) {
+            heap_.reserve(2 * N);
+            heap_.assign(inline_.begin(), inline_.end());
+        }
+        heap_.push_back(value);
+        ++size_;
+    }
+
+    iterator erase(iterator first, iterator last) {
+        std::move(last, end(), first);
+        size_ -= last - first;
+        if (!heap_.empty()) {
+            heap_.resize(size_);
+        }
+        return first;
+    }
+
+    void clear() {
+        heap_.clear();
+        size_ = 0;
+    }
+
+    Type* data() {
+        return heap_.empty() ? inline_.data() : heap_.data();
+    }
+
+    const Type* data() const {
+        return heap_.empty() ? inline_.data() : heap_.data();
+    }
+
+    iterator begin() {
+        return data();
+    }
+
+    iterator end() {
+        return data() + size_;
+    }
+
+    const_iterator begin() const {
+        return data();
+    }
+
+    const_iterator end() const {
+        return data() + size_;
+    }
+
+    Type& operator[](size_t index) {
+        return data()[index];
+    }
+
+    const Type& operator[](size_t index) const {
+        return data()[index];
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+private:
+    std::array<Type, N> inline_;
+    std::vector<Type> heap_;
+    size_t size_ = 0;
+};
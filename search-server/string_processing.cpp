@@ -1,4 +1,5 @@
 #include "string_processing.h"
+#include <algorithm>
 
 using namespace std;
 
@@ -20,4 +21,59 @@ vector<string_view> SplitIntoWords(string_view text) {
         pos = text.find_first_not_of(" ", space);
     }
     return result;
+}
+
+WordIterator::WordIterator(string_view text)
+    :rest_(text) {
+    ++*this;
+}
+
+WordIterator::reference WordIterator::operator*() const {
+    return word_;
+}
+
+WordIterator::pointer WordIterator::operator->() const {
+    return &word_;
+}
+
+//      string_view   ,    end
+WordIterator& WordIterator::operator++() {
+    const size_t pos = rest_.find_first_not_of(' ');
+    if (pos == rest_.npos) {
+        word_ = {};
+        rest_ = {};
+        return *this;
+    }
+
+    rest_.remove_prefix(pos);
+    const size_t space = min(rest_.find(' '), rest_.size());
+    word_ = rest_.substr(0, space);
+    rest_.remove_prefix(space);
+    return *this;
+}
+
+WordIterator WordIterator::operator++(int) {
+    WordIterator previous = *this;
+    ++*this;
+    return previous;
+}
+
+bool WordIterator::operator==(const WordIterator& other) const {
+    return word_.data() == other.word_.data();
+}
+
+bool WordIterator::operator!=(const WordIterator& other) const {
+    return !(*this == other);
+}
+
+WordRange::WordRange(string_view text)
+    :text_(text) {
+}
+
+WordIterator WordRange::begin() const {
+    return WordIterator(text_);
+}
+
+WordIterator WordRange::end() const {
+    return WordIterator();
 }
\ No newline at end of file
@@ -3,9 +3,47 @@
 #include <string>
 #include <string_view>
 #include <set>
+#include <iterator>
     
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+//   :      ,   
+class WordIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view*;
+    using reference = const std::string_view&;
+
+    WordIterator() = default;
+    explicit WordIterator(std::string_view text);
+
+    reference operator*() const;
+    pointer operator->() const;
+
+    WordIterator& operator++();
+    WordIterator operator++(int);
+
+    bool operator==(const WordIterator& other) const;
+    bool operator!=(const WordIterator& other) const;
+
+private:
+    std::string_view word_;
+    std::string_view rest_;
+};
+
+class WordRange {
+public:
+    explicit WordRange(std::string_view text);
+
+    WordIterator begin() const;
+    WordIterator end() const;
+
+private:
+    std::string_view text_;
+};
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings);
 
@@ -0,0 +1,144 @@
+#include "term_pool.h"
+#include "memory_usage.h"
+
+#include <cstring>
+
+using namespace std;
+
+TermPool::TermPool()
+    : nodes_(1, Node{ -1, 0, -1, 0, 0 }) {
+}
+
+int TermPool::Add(string_view term) {
+    uint32_t node = 0;
+    size_t depth = 0;
+    while (depth < term.size()) {
+        const unsigned char c = static_cast<unsigned char>(term[depth]);
+        uint32_t previous = 0;
+        uint32_t child = nodes_[node].first_child;
+        while (child != 0 && GetFirstChar(child, depth) < c) {
+            previous = child;
+            child = nodes_[child].next_sibling;
+        }
+
+        if (child == 0 || GetFirstChar(child, depth) != c) {
+            const int term_id = Store(term);
+            LinkChild(node, previous, AddNode(term_id, term.size() - depth, term_id, child));
+            return term_id;
+        }
+
+        const string_view label = GetLabel(child, depth);
+        size_t common_length = 1;
+        while (common_length < label.size() && depth + common_length < term.size()
+            && label[common_length] == term[depth + common_length]) {
+            ++common_length;
+        }
+
+        if (common_length < label.size()) {
+            //    :       
+            const uint32_t middle = AddNode(nodes_[child].label_term_id, common_length, -1, nodes_[child].next_sibling);
+            nodes_[middle].first_child = child;
+            nodes_[child].label_length -= static_cast<uint32_t>(common_length);
+            nodes_[child].next_sibling = 0;
+            LinkChild(node, previous, middle);
+            child = middle;
+        }
+
+        depth += common_length;
+        node = child;
+    }
+
+    if (nodes_[node].term_id < 0) {
+        nodes_[node].term_id = Store(term);
+    }
+    return nodes_[node].term_id;
+}
+
+int TermPool::Find(string_view term) const {
+    uint32_t node = 0;
+    size_t depth = 0;
+    while (depth < term.size()) {
+        const uint32_t child = FindChild(node, depth, term[depth]);
+        if (child == 0) {
+            return -1;
+        }
+        const string_view label = GetLabel(child, depth);
+        if (term.substr(depth, label.size()) != label) {
+            return -1;
+        }
+        depth += label.size();
+        node = child;
+    }
+    return nodes_[node].term_id;
+}
+
+string_view TermPool::GetTerm(int term_id) const {
+    return terms_[term_id];
+}
+
+size_t TermPool::GetTermCount() const {
+    return terms_.size();
+}
+
+size_t TermPool::GetMemoryUsage() const {
+    return block_bytes_ + GetHeapSize(blocks_) + GetHeapSize(terms_) + GetHeapSize(nodes_);
+}
+
+size_t TermPool::EstimateTermMemory(size_t term_length) {
+    return term_length + sizeof(string_view) + 2 * sizeof(Node);
+}
+
+string_view TermPool::GetLabel(uint32_t node, size_t depth) const {
+    return terms_[nodes_[node].label_term_id].substr(depth, nodes_[node].label_length);
+}
+
+unsigned char TermPool::GetFirstChar(uint32_t node, size_t depth) const {
+    return static_cast<unsigned char>(terms_[nodes_[node].label_term_id][depth]);
+}
+
+uint32_t TermPool::FindChild(uint32_t node, size_t depth, char c) const {
+    const unsigned char first_char = static_cast<unsigned char>(c);
+    for (uint32_t child = nodes_[node].first_child; child != 0; child = nodes_[child].next_sibling) {
+        const unsigned char child_char = GetFirstChar(child, depth);
+        if (child_char >= first_char) {
+            return child_char == first_char ? child : 0;
+        }
+    }
+    return 0;
+}
+
+void TermPool::LinkChild(uint32_t parent, uint32_t previous, uint32_t child) {
+    if (previous == 0) {
+        nodes_[parent].first_child = child;
+    }
+    else {
+        nodes_[previous].next_sibling = child;
+    }
+}
+
+uint32_t TermPool::AddNode(int label_term_id, size_t label_length, int term_id, uint32_t next_sibling) {
+    nodes_.push_back({ label_term_id, static_cast<uint32_t>(label_length), term_id, 0, next_sibling });
+    return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+int TermPool::Store(string_view term) {
+    const int term_id = static_cast<int>(terms_.size());
+    if (term.empty()) {
+        terms_.push_back({});
+        return term_id;
+    }
+
+    //     
+    if (block_used_ + term.size() > block_size_) {
+        block_size_ = max(clamp(block_bytes_, TERM_POOL_MIN_BLOCK_SIZE, TERM_POOL_MAX_BLOCK_SIZE), term.size());
+        blocks_.push_back(make_unique<char[]>(block_size_));
+        block_bytes_ += block_size_;
+        block_used_ = 0;
+    }
+
+    char* data = blocks_.back().get() + block_used_;
+    memcpy(data, term.data(), term.size());
+    block_used_ += term.size();
+    terms_.push_back({ data, term.size() });
+    return term_id;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+//       ,      
+const size_t TERM_POOL_MIN_BLOCK_SIZE = 1024;
+const size_t TERM_POOL_MAX_BLOCK_SIZE = 64 * 1024;
+
+// .          ,
+// string_view             .
+//     :    ,     
+class TermPool {
+public:
+    TermPool();
+
+    // id ,      
+    int Add(std::string_view term);
+    //-1,   
+    int Find(std::string_view term) const;
+    std::string_view GetTerm(int term_id) const;
+
+    //     .  ,  function  false
+    template <typename Function>
+    void ForEachTermWithPrefix(std::string_view prefix, Function function) const;
+
+    size_t GetTermCount() const;
+    size_t GetMemoryUsage() const;
+    //   :   ,  terms_            
+    static size_t EstimateTermMemory(size_t term_length);
+
+private:
+    struct Node {
+        //     label_term_id,    
+        int label_term_id;
+        uint32_t label_length;
+        int term_id;
+        //0   :     ,  
+        uint32_t first_child;
+        uint32_t next_sibling;
+    };
+
+    std::string_view GetLabel(uint32_t node, size_t depth) const;
+    unsigned char GetFirstChar(uint32_t node, size_t depth) const;
+    uint32_t FindChild(uint32_t node, size_t depth, char c) const;
+    uint32_t AddNode(int label_term_id, size_t label_length, int term_id, uint32_t next_sibling);
+    //previous  ,    child,  0,  child  
+    void LinkChild(uint32_t parent, uint32_t previous, uint32_t child);
+
+    int Store(std::string_view term);
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    size_t block_bytes_ = 0;
+    size_t block_used_ = 0;
+    size_t block_size_ = 0;
+
+    std::vector<std::string_view> terms_;
+    //         
+    std::vector<Node> nodes_;
+};
+
+template <typename Function>
+void TermPool::ForEachTermWithPrefix(std::string_view prefix, Function function) const {
+    uint32_t node = 0;
+    size_t depth = 0;
+    while (depth < prefix.size()) {
+        const uint32_t child = FindChild(node, depth, prefix[depth]);
+        if (child == 0) {
+            return;
+        }
+        //    :    
+        const std::string_view label = GetLabel(child, depth);
+        const size_t length = std::min(label.size(), prefix.size() - depth);
+        if (label.substr(0, length) != prefix.substr(depth, length)) {
+            return;
+        }
+        depth += label.size();
+        node = child;
+    }
+
+    std::vector<uint32_t> stack = { node };
+    while (!stack.empty()) {
+        const Node& current = nodes_[stack.back()];
+        stack.pop_back();
+        if (current.term_id >= 0 && !function(current.term_id, terms_[current.term_id])) {
+            return;
+        }
+
+        const size_t first_child_index = stack.size();
+        for (uint32_t child = current.first_child; child != 0; child = nodes_[child].next_sibling) {
+            stack.push_back(child);
+        }
+        std::reverse(stack.begin() + first_child_index, stack.end());
+    }
+}